@@ -0,0 +1,123 @@
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+#include "chip8.h"
+
+
+namespace
+{
+	// Number of instructions to run per stream; enough to hide timer noise
+	constexpr std::size_t kInstructions = 10'000'000;
+	
+	void Push(std::vector<uint8_t>& code, uint16_t ins)
+	{
+		code.push_back(ins >> 8);
+		code.push_back(ins & 0xFF);
+	}
+	
+	void PushLoopBack(std::vector<uint8_t>& code)
+	{
+		// Jump back to the entry point at 0x200
+		Push(code, 0x1200);
+	}
+	
+	// Pure register ALU work through the 8xyN family
+	std::vector<uint8_t> MakeALUStream()
+	{
+		std::vector<uint8_t> code;
+		
+		// Seed some registers to churn
+		Push(code, 0x60A5);
+		Push(code, 0x615A);
+		Push(code, 0x6233);
+		
+		for (std::size_t i = 0; i < 32; i++)
+		{
+			Push(code, 0x8014);	// V0 += V1
+			Push(code, 0x8121);	// V1 |= V2
+			Push(code, 0x8232);	// V2 &= V3
+			Push(code, 0x8103);	// V1 ^= V0
+			Push(code, 0x8206);	// V2 >>= 1
+			Push(code, 0x800E);	// V0 <<= 1
+		}
+		
+		PushLoopBack(code);
+		return code;
+	}
+	
+	// Branch-heavy work through 3xnn/4xnn skips and 1nnn jumps
+	std::vector<uint8_t> MakeBranchStream()
+	{
+		std::vector<uint8_t> code;
+		
+		// V0 is zero, so 3x never skips and 4x always does
+		Push(code, 0x6000);
+		
+		for (std::size_t i = 0; i < 32; i++)
+		{
+			Push(code, 0x30AA);	// not taken
+			Push(code, 0x40AA);	// taken, skips the filler
+			Push(code, 0x6100);	// filler that gets skipped
+		}
+		
+		PushLoopBack(code);
+		return code;
+	}
+	
+	// Sprite-heavy work through Dxyn using the built-in character sprites
+	std::vector<uint8_t> MakeSpriteStream()
+	{
+		std::vector<uint8_t> code;
+		
+		Push(code, 0x6005);	// X
+		Push(code, 0x6107);	// Y
+		Push(code, 0x623C);	// X for the wrapping draws
+		Push(code, 0xA010);	// I = character sprite data
+		
+		for (std::size_t i = 0; i < 16; i++)
+		{
+			// Alternate an aligned draw with a wrapping one so both blit
+			// paths are covered; each pair XORs itself back off the display
+			Push(code, 0xD015);
+			Push(code, 0xD015);
+			Push(code, 0xD215);
+			Push(code, 0xD215);
+		}
+		
+		PushLoopBack(code);
+		return code;
+	}
+	
+	void RunStream(const char * name, const std::vector<uint8_t>& code)
+	{
+		emu::CHIP8 chip8;
+		if (!chip8.Load(code.data(), code.size(), emu::CHIP8::Program::CHIP8))
+		{
+			printf("%-8s failed to load\n", name);
+			return;
+		}
+		
+		// Time the whole batch in one Step call
+		const auto start = emu::CHIP8::Clock::now();
+		chip8.Step(kInstructions);
+		const auto end = emu::CHIP8::Clock::now();
+		
+		const double seconds = std::chrono::duration<double>(end - start).count();
+		const double mips = (kInstructions / seconds) / 1'000'000.0;
+		const double nsPerOp = (seconds * 1'000'000'000.0) / kInstructions;
+		
+		printf("%-8s %8.1f MIPS %8.2f ns/op\n", name, mips, nsPerOp);
+	}
+}
+
+
+
+int main()
+{
+	RunStream("alu", MakeALUStream());
+	RunStream("branch", MakeBranchStream());
+	RunStream("sprite", MakeSpriteStream());
+	
+	return 0;
+}
@@ -1,4 +1,13 @@
+#include <algorithm>
 #include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
 #include "chip8.h"
 
 namespace
@@ -11,160 +20,433 @@ namespace
 		return o;
 	}
 	
-	constexpr uint8_t kCharacterSprites[5 * 16] = {
-		// 0
-		0b11110000,
-		0b10010000,
-		0b10010000,
-		0b10010000,
-		0b11110000,
-		
-		// 1
-		0b01100000,
-		0b10100000,
-		0b00100000,
-		0b00100000,
-		0b11110000,
-		
-		// 2
-		0b11110000,
-		0b00010000,
-		0b11110000,
-		0b10000000,
-		0b11110000,
-		
-		// 3
-		0b11110000,
-		0b00010000,
-		0b11110000,
-		0b00010000,
-		0b11110000,
-		
-		// 4
-		0b10010000,
-		0b10010000,
-		0b11110000,
-		0b00010000,
-		0b00010000,
-		
-		// 5
-		0b11110000,
-		0b10000000,
-		0b11110000,
-		0b00010000,
-		0b11110000,
-		
-		// 6
-		0b11110000,
-		0b10000000,
-		0b11110000,
-		0b10010000,
-		0b11110000,
-		
-		// 7
-		0b11110000,
-		0b00010000,
-		0b00010000,
-		0b00010000,
-		0b00010000,
-		
-		// 8
-		0b11110000,
-		0b10010000,
-		0b11110000,
-		0b10010000,
-		0b11110000,
-		
-		// 9
-		0b11110000,
-		0b10010000,
-		0b11110000,
-		0b00010000,
-		0b00010000,
-		
-		// A
-		0b11110000,
-		0b10010000,
-		0b11110000,
-		0b10010000,
-		0b10010000,
-		
-		// B
-		0b11100000,
-		0b10010000,
-		0b11100000,
-		0b10010000,
-		0b11100000,
-		
-		// C
-		0b11110000,
-		0b10000000,
-		0b10000000,
-		0b10000000,
-		0b11110000,
-		
-		// D
-		0b11100000,
-		0b10010000,
-		0b10010000,
-		0b10010000,
-		0b11100000,
-		
-		// E
-		0b11110000,
-		0b10000000,
-		0b11110000,
-		0b10000000,
-		0b11110000,
-		
-		// F
-		0b11110000,
-		0b10000000,
-		0b11110000,
-		0b10000000,
-		0b10000000,
-	};
+	// For each byte value, its bits spread out MSB-first to one byte each:
+	// 0xFF where the bit was set and 0x00 where it was clear
+	constexpr std::array<uint64_t, 256> MakeBitSpreadTable()
+	{
+		std::array<uint64_t, 256> table{};
+		for (size_t value = 0; value < table.size(); value++)
+		{
+			uint64_t spread = 0;
+			for (size_t bit = 0; bit < 8; bit++)
+			{
+				if (value & (1u << (7 - bit)))
+				{
+					spread |= uint64_t{0xFF} << (bit * 8);
+				}
+			}
+			table[value] = spread;
+		}
+		return table;
+	}
+	
+	constexpr std::array<uint64_t, 256> kBitSpread = MakeBitSpreadTable();
 }
 
 namespace emu
 {
+	ROM::~ROM()
+	{
+		Unmap();
+	}
+	
+	ROM::ROM(ROM&& other) noexcept
+		: mData{std::move(other.mData)}
+		, mMapped{other.mMapped}
+		, mMappedSize{other.mMappedSize}
+	{
+		other.mMapped = nullptr;
+		other.mMappedSize = 0;
+	}
+	
+	ROM& ROM::operator=(ROM&& other) noexcept
+	{
+		if (this != &other)
+		{
+			Unmap();
+			mData = std::move(other.mData);
+			mMapped = other.mMapped;
+			mMappedSize = other.mMappedSize;
+			other.mMapped = nullptr;
+			other.mMappedSize = 0;
+		}
+		return *this;
+	}
+	
 	bool ROM::Load(const void* data, std::size_t size)
 	{
+		Unmap();
 		mData.resize(size);
 		std::memcpy(mData.data(), data, size);
 		return true;
 	}
 	
+	bool ROM::LoadFile(const char* path)
+	{
+		// Open the file
+		const int fd = open(path, O_RDONLY);
+		if (fd < 0)
+		{
+			return false;
+		}
+		
+		// Get the size
+		struct stat info;
+		if (fstat(fd, &info) != 0 || info.st_size <= 0)
+		{
+			close(fd);
+			return false;
+		}
+		const std::size_t size = info.st_size;
+		
+		// Map it in place of copying it
+		void * mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		
+		// The mapping keeps its own reference to the file
+		close(fd);
+		
+		if (mapping == MAP_FAILED)
+		{
+			return false;
+		}
+		
+		Unmap();
+		mData.clear();
+		mMapped = static_cast<const std::byte*>(mapping);
+		mMappedSize = size;
+		
+		return true;
+	}
+	
+	void ROM::Unmap()
+	{
+		if (mMapped != nullptr)
+		{
+			munmap(const_cast<std::byte*>(mMapped), mMappedSize);
+			mMapped = nullptr;
+			mMappedSize = 0;
+		}
+	}
+	
+	ROM::Analysis ROM::Analyze(std::size_t entryPoint) const
+	{
+		Analysis analysis = {};
+		analysis.valid = true;
+		
+		const uint8_t * data = reinterpret_cast<const uint8_t*>(Data());
+		
+		// Everything is tracked in RAM addresses, same as the decode cache.
+		// The walk is clamped to the RAM window: this pass vets untrusted
+		// files before loading, so an oversized image must not walk visited
+		// off the end rather than just failing Load later.
+		std::vector<uint8_t> visited(4096, 0);
+		const std::size_t end = std::min(entryPoint + Size(), visited.size());
+		std::vector<uint16_t> worklist;
+		std::vector<uint16_t> setITargets;
+		bool storesThroughI = false;
+		
+		auto addLeader = [&](uint16_t address)
+		{
+			analysis.blockStarts.push_back(address);
+			worklist.push_back(address);
+		};
+		addLeader(entryPoint);
+		
+		while (!worklist.empty())
+		{
+			std::size_t pc = worklist.back();
+			worklist.pop_back();
+			
+			// Follow straight-line code until something redirects it
+			while (true)
+			{
+				// Paths that leave the image can't be analysed statically, so
+				// they end here rather than failing the ROM
+				if (pc < entryPoint || pc + sizeof(CHIP8::Instruction) > end || visited[pc])
+				{
+					break;
+				}
+				visited[pc] = 1;
+				
+				const CHIP8::Instruction ins = (data[pc - entryPoint] << 8) | data[pc - entryPoint + 1];
+				const CHIP8::Address nnn = ins & 0x0FFF;
+				
+				// Classify through the same table Step dispatches with
+				const uint8_t handler = CHIP8::ResolveHandler(ins);
+				if (handler == CHIP8::kHandler_Unknown)
+				{
+					if (analysis.valid)
+					{
+						analysis.valid = false;
+						analysis.firstInvalid = pc;
+					}
+					break;
+				}
+				
+				bool fallsThrough = true;
+				switch (handler)
+				{
+					case CHIP8::kHandler_Jump:
+						addLeader(nnn);
+						fallsThrough = false;
+						break;
+					
+					case CHIP8::kHandler_Call:
+						addLeader(nnn);
+						addLeader(pc + sizeof(CHIP8::Instruction));
+						fallsThrough = false;
+						break;
+					
+					case CHIP8::kHandler_SkipEqualImm:
+					case CHIP8::kHandler_SkipNotEqualImm:
+					case CHIP8::kHandler_SkipEqual:
+					case CHIP8::kHandler_SkipNotEqual:
+					case CHIP8::kHandler_SkipKeyPressed:
+					case CHIP8::kHandler_SkipKeyNotPressed:
+						// Both arms start blocks
+						addLeader(pc + sizeof(CHIP8::Instruction));
+						addLeader(pc + 2 * sizeof(CHIP8::Instruction));
+						fallsThrough = false;
+						break;
+					
+					case CHIP8::kHandler_SetI:
+						setITargets.push_back(nnn);
+						break;
+					
+					case CHIP8::kHandler_StoreBCD:
+					case CHIP8::kHandler_StoreRegisters:
+						storesThroughI = true;
+						break;
+					
+					case CHIP8::kHandler_Ret:
+					case CHIP8::kHandler_Exit:
+					case CHIP8::kHandler_JumpV0:	// dynamic target
+						fallsThrough = false;
+						break;
+				}
+				
+				if (!fallsThrough)
+				{
+					break;
+				}
+				pc += sizeof(CHIP8::Instruction);
+			}
+		}
+		
+		// Dedup and sort the collected leaders and Annn targets
+		auto tidy = [](std::vector<uint16_t>& addresses)
+		{
+			std::sort(addresses.begin(), addresses.end());
+			addresses.erase(std::unique(addresses.begin(), addresses.end()), addresses.end());
+		};
+		tidy(analysis.blockStarts);
+		tidy(setITargets);
+		analysis.spriteAddresses = setITargets;
+		
+		// A store through I whose Annn base lands in visited code may rewrite
+		// instructions; I is also arithmetic (Fx1E) so this stays conservative
+		if (storesThroughI)
+		{
+			for (const uint16_t target : setITargets)
+			{
+				if (target < visited.size() && visited[target])
+				{
+					analysis.usesSelfModifyingCode = true;
+					break;
+				}
+			}
+		}
+		
+		return analysis;
+	}
+	
+	
+	// One handler per sub-opcode, indexed by DecodedOp::handler in enum order
+	const CHIP8::Handler CHIP8::kHandlers[CHIP8::kHandlerCount] = {
+		&CHIP8::Handle_Cls,
+		&CHIP8::Handle_Ret,
+		&CHIP8::Handle_ScrollDown,
+		&CHIP8::Handle_ScrollRight,
+		&CHIP8::Handle_ScrollLeft,
+		&CHIP8::Handle_Exit,
+		&CHIP8::Handle_LoresMode,
+		&CHIP8::Handle_HiresMode,
+		&CHIP8::Handle_Jump,
+		&CHIP8::Handle_Call,
+		&CHIP8::Handle_SkipEqualImm,
+		&CHIP8::Handle_SkipNotEqualImm,
+		&CHIP8::Handle_SkipEqual,
+		&CHIP8::Handle_SetImm,
+		&CHIP8::Handle_AddImm,
+		&CHIP8::Handle_Set,
+		&CHIP8::Handle_Or,
+		&CHIP8::Handle_And,
+		&CHIP8::Handle_Xor,
+		&CHIP8::Handle_Add,
+		&CHIP8::Handle_Sub,
+		&CHIP8::Handle_ShiftRight,
+		&CHIP8::Handle_SubFrom,
+		&CHIP8::Handle_ShiftLeft,
+		&CHIP8::Handle_SkipNotEqual,
+		&CHIP8::Handle_SetI,
+		&CHIP8::Handle_JumpV0,
+		&CHIP8::Handle_Random,
+		&CHIP8::Handle_Draw,
+		&CHIP8::Handle_SkipKeyPressed,
+		&CHIP8::Handle_SkipKeyNotPressed,
+		&CHIP8::Handle_GetDelay,
+		&CHIP8::Handle_WaitKey,
+		&CHIP8::Handle_SetDelay,
+		&CHIP8::Handle_SetSound,
+		&CHIP8::Handle_AddI,
+		&CHIP8::Handle_CharacterSprite,
+		&CHIP8::Handle_BigCharacterSprite,
+		&CHIP8::Handle_StoreBCD,
+		&CHIP8::Handle_StoreRegisters,
+		&CHIP8::Handle_LoadRegisters,
+		&CHIP8::Handle_StoreUserFlags,
+		&CHIP8::Handle_LoadUserFlags,
+		&CHIP8::Handle_Unknown,
+	};
+	
+	// Rough relative costs in kInstructionsPerTick-style units: register ops
+	// are the baseline, anything that walks display memory is charged for it
+	const uint8_t CHIP8::kHandlerCycles[CHIP8::kHandlerCount] =
+	{
+		24,	// kHandler_Cls
+		1,	// kHandler_Ret
+		24,	// kHandler_ScrollDown
+		32,	// kHandler_ScrollRight
+		32,	// kHandler_ScrollLeft
+		1,	// kHandler_Exit
+		24,	// kHandler_LoresMode
+		24,	// kHandler_HiresMode
+		1,	// kHandler_Jump
+		1,	// kHandler_Call
+		1,	// kHandler_SkipEqualImm
+		1,	// kHandler_SkipNotEqualImm
+		1,	// kHandler_SkipEqual
+		1,	// kHandler_SetImm
+		1,	// kHandler_AddImm
+		1,	// kHandler_Set
+		1,	// kHandler_Or
+		1,	// kHandler_And
+		1,	// kHandler_Xor
+		1,	// kHandler_Add
+		1,	// kHandler_Sub
+		1,	// kHandler_ShiftRight
+		1,	// kHandler_SubFrom
+		1,	// kHandler_ShiftLeft
+		1,	// kHandler_SkipNotEqual
+		1,	// kHandler_SetI
+		1,	// kHandler_JumpV0
+		2,	// kHandler_Random
+		40,	// kHandler_Draw
+		1,	// kHandler_SkipKeyPressed
+		1,	// kHandler_SkipKeyNotPressed
+		1,	// kHandler_GetDelay
+		1,	// kHandler_WaitKey
+		1,	// kHandler_SetDelay
+		1,	// kHandler_SetSound
+		1,	// kHandler_AddI
+		1,	// kHandler_CharacterSprite
+		1,	// kHandler_BigCharacterSprite
+		3,	// kHandler_StoreBCD
+		4,	// kHandler_StoreRegisters
+		4,	// kHandler_LoadRegisters
+		2,	// kHandler_StoreUserFlags
+		2,	// kHandler_LoadUserFlags
+		1,	// kHandler_Unknown
+	};
 	
 	CHIP8::CHIP8()
-		: mRAM{}
-		, mDisplayBuffer{}
-		, mRegisters{}
-		, mPC{}
-		, mI{}
-		, mDelayTimer{}
-		, mSoundTimer{}
-		, mKeyboard{}
-		, mKeyboardRegister{0xFF}
-		, mStackFrames{}
-		, mStack{}
+		: mLazyTimers{false}
+		, mFrameSeq{0}
+	{
+		// Everything else is assigned by ReInit so pooled instances reset
+		// through exactly the same path as construction
+		ReInit();
+	}
+	
+	void CHIP8::ReInit()
+	{
+		mRAM = {};
+		mDisplayBuffer = {};
+		mHiresDisplay = {};
+		mHires = false;
+		mHalted = false;
+		mRegisters = {};
+		mUserFlags = {};
+		mPC = 0;
+		mI = 0;
+		mDelayTimer = 0;
+		mSoundTimer = 0;
+		mDelaySetAt = 0;
+		mSoundSetAt = 0;
+		mKeyboard = {};
+		mKeyboardRegister = 0xFF;
+		mStackFrames = {};
+		mStack = 0;
+		mInstructionCount = 0;
+		mRngState = 0x853C49E6748FEA9Bull;
+		mDisplayDirty = false;
+		mDirtyRowFirst = 0;
+		mDirtyRowLast = 0;
+		mFrontBuffer = {};
+		mFramePending = false;
+		
+		// Only the handler sentinels need clearing, not the whole cache, and
+		// the frame sequence deliberately stays put so a renderer that spans
+		// a reset keeps seeing a monotonic generation
+		InvalidateDecodeCache(0, mDecodeCache.size());
+		mDecodeInDisplay = false;
+		
+		mRecording = nullptr;
+		mFrameSink = nullptr;
+		mFrameCounter = 0;
+		mKeyEvents.clear();
+		mTraceCount = 0;
+
+#if defined(CHIP8_INSTRUMENTATION)
+		ResetStats();
+#endif
+	}
+	
+	CHIP8::CHIP8(const CHIP8& other)
+		: CHIP8()
+	{
+		Restore(other.TakeSnapshot());
+	}
+	
+	CHIP8& CHIP8::operator=(const CHIP8& other)
 	{
+		Restore(other.TakeSnapshot());
+		return *this;
 	}
 	
 	bool CHIP8::Load(const ROM& rom, Program type)
+	{
+		return Load(rom.Data(), rom.Size(), type);
+	}
+	
+	bool CHIP8::Load(const void* data, std::size_t size, Program type)
 	{
 		bool loaded = false;
-		const auto& data = rom.GetData();
 		
 		// Different types of programs start at different offsets
-		const size_t offset = type == Program::CHIP8 ? 0x200 : 0x600;
+		const size_t offset = EntryPoint(type);
 		
-		if (data.size() + offset < mRAM.size())
+		if (size + offset < mRAM.size())
 		{
-			std::copy(data.begin(), data.end(), mRAM.begin() + offset);
+			// Copy straight into RAM; the caller's buffer can be a mapping
+			std::memcpy(&mRAM[offset], data, size);
 			mPC = offset;
 			
-			std::memcpy(&mRAM[kCharacterSpritesStart], kCharacterSprites, sizeof(kCharacterSprites));
+			std::memcpy(&mRAM[kCharacterSpritesStart], detail::kCharacterSprites, sizeof(detail::kCharacterSprites));
+			std::memcpy(&mRAM[kBigCharacterSpritesStart], detail::kBigCharacterSprites.data(), detail::kBigCharacterSprites.size());
+			
+			// Throw away any translations of whatever was loaded before
+			InvalidateDecodeCache(0, mRAM.size());
 			
 			loaded = true;
 		}
@@ -172,13 +454,73 @@ namespace emu
 		return loaded;
 	}
 	
-	void CHIP8::Step(std::size_t instructions)
+	bool CHIP8::Load(const MachineImage& image)
+	{
+		// The image is pre-composed, so this is a single copy with no fixups
+		mRAM = image.ram;
+		mPC = image.pc;
+		
+		// Throw away any translations of whatever was loaded before
+		InvalidateDecodeCache(0, mRAM.size());
+		
+		return true;
+	}
+	
+	CHIP8::StepResult CHIP8::Step(std::size_t instructions)
+	{
+		// Every instruction costs one unit, so the budget is an instruction count
+		StepBudget(instructions, nullptr);
+		
+		if (mHalted)
+		{
+			return StepResult::Halted;
+		}
+		if (WaitingForKey())
+		{
+			return StepResult::WaitingForKey;
+		}
+		return StepResult::Completed;
+	}
+	
+	std::size_t CHIP8::StepCycles(std::size_t cycleBudget)
+	{
+		return StepBudget(cycleBudget, kHandlerCycles);
+	}
+	
+	std::size_t CHIP8::StepBudget(std::size_t budget, const uint8_t * cycleCosts)
 	{
-		for (size_t i = 0; i < instructions; i++)
+		// Apply any key transitions queued since the last call in one batch.
+		// While Fx0A is waiting they're instead fed through one at a time
+		// below, so a press/release pair can't be collapsed away and missed.
+		std::size_t nextKeyEvent = 0;
+		if (mKeyboardRegister == 0xFF)
+		{
+			for (; nextKeyEvent < mKeyEvents.size(); nextKeyEvent++)
+			{
+				ApplyKeyEvent(mKeyEvents[nextKeyEvent]);
+			}
+		}
+		
+		std::size_t consumed = 0;
+		uint64_t traceCount = mTraceCount;
+		while (consumed < budget)
 		{
+			// A program that has exited stays exited
+			if (mHalted)
+			{
+				break;
+			}
+			
 			// Wait for input if we need to
 			if (mKeyboardRegister != 0xFF)
 			{
+				// Feed queued transitions through until one is a press
+				while (!mKeyboard.any() && nextKeyEvent < mKeyEvents.size())
+				{
+					ApplyKeyEvent(mKeyEvents[nextKeyEvent]);
+					nextKeyEvent++;
+				}
+				
 				if (!mKeyboard.any())
 				{
 					// No button presses yet
@@ -198,26 +540,315 @@ namespace emu
 				}
 			}
 			
-			// Read the next instruction
-			const Instruction ins = ReadInstruction();
+			// Read the next instruction, translating it if this is the first
+			// time we've executed this address
+			const Address pc = mPC;
+			const DecodedOp& op = Decode();
+			
+			// Feed the flight recorder. The count lives in a local so the
+			// loop doesn't carry a load through memory every instruction, but
+			// is stored back before dispatch so OnError dumps a current trace.
+			TraceRecord& record = mTrace[traceCount & (kTraceLength - 1)];
+			record.pc = pc;
+			record.ins = op.ins;
+			traceCount++;
+			mTraceCount = traceCount;
+			
+#if defined(CHIP8_INSTRUMENTATION)
+			// Credit the instruction to its opcode family and PC range
+			mStats.opcodeCounts[op.ins >> 12]++;
+			mStats.pcRangeCounts[(mPC - sizeof(Instruction)) >> 7]++;
+#endif
+			
+			// Handle it. Grab the handler index first: a self-modifying store
+			// inside the handler can invalidate the cache entry op refers to.
+			const uint8_t handler = op.handler;
+			(this->*kHandlers[handler])(op);
+			mInstructionCount++;
+			consumed += cycleCosts != nullptr ? cycleCosts[handler] : 1;
+		}
+		
+		// Drop whatever was applied; anything left stays queued for next time
+		mKeyEvents.erase(mKeyEvents.begin(), mKeyEvents.begin() + nextKeyEvent);
+		
+		// Seal whatever this slice drew so a renderer thread can pick it up
+		PublishFrame();
+		
+		return consumed;
+	}
+	
+	std::size_t CHIP8::RunUntil(Clock::time_point deadline, std::size_t maxInstructions)
+	{
+		const uint64_t start = mInstructionCount;
+		
+		while (mInstructionCount - start < maxInstructions)
+		{
+			// Run a timer period's worth of instructions in one go rather than
+			// bouncing between the host and the interpreter per instruction
+			const std::size_t remaining = maxInstructions - (mInstructionCount - start);
+			const uint64_t before = mInstructionCount;
+			Step(std::min(kInstructionsPerTick, remaining));
+			Tick();
+			
+			// Give control back if we're blocked waiting for a key press
+			if (mInstructionCount == before)
+			{
+				break;
+			}
+			
+			// Or if there's now a frame for the host to present
+			if (NeedsRedraw())
+			{
+				break;
+			}
 			
-			// Handle it
-			switch (ins / 0x1000)
+			// Or if we're out of time
+			if (Clock::now() >= deadline)
 			{
-#define CASE(x) case 0x ## x : Handle_ ## x (ins); break
-				
-				CASE(0);	CASE(1);	CASE(2);	CASE(3);
-				CASE(4);	CASE(5);	CASE(6);	CASE(7);
-				CASE(8);	CASE(9);	CASE(A);	CASE(B);
-				CASE(C);	CASE(D);	CASE(E);	CASE(F);
+				break;
+			}
+		}
+		
+		return mInstructionCount - start;
+	}
+	
+	CHIP8::Snapshot CHIP8::TakeSnapshot() const
+	{
+		// Zero-initialised so the struct's padding bytes are deterministic,
+		// which StateHash() and the savestate files both rely on
+		Snapshot snapshot = {};
+		
+		snapshot.ram = mRAM;
+		snapshot.displayBuffer = mDisplayBuffer;
+		snapshot.hiresDisplay = mHiresDisplay;
+		std::copy(mRegisters.begin(), mRegisters.end(), snapshot.registers.begin());
+		std::copy(mUserFlags.begin(), mUserFlags.end(), snapshot.userFlags.begin());
+		snapshot.pc = mPC;
+		snapshot.i = mI;
+		snapshot.delayTimer = mDelayTimer;
+		snapshot.soundTimer = mSoundTimer;
+		snapshot.keyboard = static_cast<uint16_t>(mKeyboard.to_ulong());
+		snapshot.keyboardRegister = mKeyboardRegister;
+		snapshot.stack = mStack;
+		snapshot.hires = mHires ? 1 : 0;
+		snapshot.halted = mHalted ? 1 : 0;
+		std::copy(mStackFrames.begin(), mStackFrames.end(), snapshot.stackFrames.begin());
+		snapshot.instructionCount = mInstructionCount;
+		snapshot.rngState = mRngState;
+		snapshot.delaySetAt = mDelaySetAt;
+		snapshot.soundSetAt = mSoundSetAt;
+		snapshot.lazyTimers = mLazyTimers ? 1 : 0;
+		
+		return snapshot;
+	}
+	
+	void CHIP8::Restore(const Snapshot& snapshot)
+	{
+		mRAM = snapshot.ram;
+		mDisplayBuffer = snapshot.displayBuffer;
+		mHiresDisplay = snapshot.hiresDisplay;
+		std::copy(snapshot.registers.begin(), snapshot.registers.end(), mRegisters.begin());
+		std::copy(snapshot.userFlags.begin(), snapshot.userFlags.end(), mUserFlags.begin());
+		mPC = snapshot.pc;
+		mI = snapshot.i;
+		mDelayTimer = snapshot.delayTimer;
+		mSoundTimer = snapshot.soundTimer;
+		mKeyboard = snapshot.keyboard;
+		mKeyboardRegister = snapshot.keyboardRegister;
+		mStack = snapshot.stack;
+		mHires = snapshot.hires != 0;
+		mHalted = snapshot.halted != 0;
+		std::copy(snapshot.stackFrames.begin(), snapshot.stackFrames.end(), mStackFrames.begin());
+		mInstructionCount = snapshot.instructionCount;
+		mRngState = snapshot.rngState;
+		mDelaySetAt = snapshot.delaySetAt;
+		mSoundSetAt = snapshot.soundSetAt;
+		mLazyTimers = snapshot.lazyTimers != 0;
+		
+		// The restored RAM may not match what we've translated or drawn
+		InvalidateDecodeCache(0, mRAM.size());
+		mDecodeInDisplay = false;
+		MarkDisplayDirty(0, DisplayHeight() - 1);
+	}
+	
+	bool CHIP8::SaveStateTo(const char* path) const
+	{
+		// Zero first so the struct's padding bytes are deterministic on disk
+		SaveState save = {};
+		save.magic = kSaveStateMagic;
+		save.version = kSaveStateVersion;
+		save.state = TakeSnapshot();
+		
+		FILE * file = fopen(path, "wb");
+		if (file == nullptr)
+		{
+			return false;
+		}
+		
+		const bool written = fwrite(&save, sizeof(save), 1, file) == 1;
+		return fclose(file) == 0 && written;
+	}
+	
+	bool CHIP8::LoadStateFrom(const char* path)
+	{
+		// Open the file
+		const int fd = open(path, O_RDONLY);
+		if (fd < 0)
+		{
+			return false;
+		}
+		
+		// Get the size
+		struct stat info;
+		if (fstat(fd, &info) != 0 || static_cast<std::size_t>(info.st_size) < sizeof(SaveState))
+		{
+			close(fd);
+			return false;
+		}
+		
+		// Map it in place of reading it: restoring a checkpoint then only
+		// pages in the bytes that Restore() actually touches
+		void * mapping = mmap(nullptr, sizeof(SaveState), PROT_READ, MAP_PRIVATE, fd, 0);
+		
+		// The mapping keeps its own reference to the file
+		close(fd);
+		
+		if (mapping == MAP_FAILED)
+		{
+			return false;
+		}
+		
+		const SaveState * save = static_cast<const SaveState*>(mapping);
+		const bool valid = save->magic == kSaveStateMagic && save->version == kSaveStateVersion;
+		if (valid)
+		{
+			Restore(save->state);
+		}
+		
+		munmap(mapping, sizeof(SaveState));
+		return valid;
+	}
+	
+	uint64_t CHIP8::StateHash() const
+	{
+		const Snapshot snapshot = TakeSnapshot();
+		const uint8_t * bytes = reinterpret_cast<const uint8_t*>(&snapshot);
+		
+		uint64_t hash = 0xCBF29CE484222325ull;
+		for (std::size_t i = 0; i < sizeof(snapshot); i++)
+		{
+			hash ^= bytes[i];
+			hash *= 0x00000100000001B3ull;
+		}
+		return hash;
+	}
+	
+	CHIP8::SharedSnapshot CHIP8::ShareSnapshot() const
+	{
+		return std::make_shared<const Snapshot>(TakeSnapshot());
+	}
+	
+	CHIP8 CHIP8::Fork(const SharedSnapshot& snapshot)
+	{
+		CHIP8 forked;
+		forked.Restore(*snapshot);
+		return forked;
+	}
+	
+	void CHIP8::SetKeyboardState(KeyboardState state)
+	{
+		mKeyboard = state;
+		
+		if (mRecording != nullptr)
+		{
+			const uint16_t keys = static_cast<uint16_t>(state.to_ulong());
+			mRecording->events.push_back({mInstructionCount, InputRecording::Type::Keyboard, keys});
+		}
+	}
+	
+	void CHIP8::PushKeyEvent(uint8_t key, bool down)
+	{
+		if (key >= mKeyboard.size())
+		{
+			OnError("Invalid key code pushed");
+		}
+		
+		mKeyEvents.push_back({key, down});
+	}
+	
+	void CHIP8::ApplyKeyEvent(const KeyEvent& event)
+	{
+		mKeyboard[event.key] = event.down;
+		
+		// Recordings capture the resulting state, same as SetKeyboardState()
+		if (mRecording != nullptr)
+		{
+			const uint16_t keys = static_cast<uint16_t>(mKeyboard.to_ulong());
+			mRecording->events.push_back({mInstructionCount, InputRecording::Type::Keyboard, keys});
+		}
+	}
+	
+	void CHIP8::Replay(const InputRecording& recording)
+	{
+		// Suspend any active recording so the injected inputs aren't re-logged
+		InputRecording * previous = mRecording;
+		mRecording = nullptr;
+		
+		for (const auto& event : recording.events)
+		{
+			// Run flat out up to the point the input originally arrived
+			if (event.instruction > mInstructionCount)
+			{
+				Step(event.instruction - mInstructionCount);
+			}
+			
+			switch (event.type)
+			{
+				case InputRecording::Type::Keyboard:
+					mKeyboard = event.keyboard;
+					break;
 				
-#undef CASE
+				case InputRecording::Type::Tick:
+					Tick();
+					break;
 			}
 		}
+		
+		mRecording = previous;
+	}
+	
+	void CHIP8::SetSeed(uint64_t seed)
+	{
+		// The generator cycles through every value except zero, so map zero to
+		// an arbitrary non-zero state rather than sticking there forever
+		mRngState = seed != 0 ? seed : 0x853C49E6748FEA9Bull;
+	}
+	
+	uint8_t CHIP8::NextRandom()
+	{
+		// xorshift64*: small and fast, and unlike rand() it doesn't take a
+		// process-wide lock that would serialize scheduler workers
+		uint64_t state = mRngState;
+		state ^= state >> 12;
+		state ^= state << 25;
+		state ^= state >> 27;
+		mRngState = state;
+		return (state * 0x2545F4914F6CDD1Dull) >> 56;
 	}
 	
 	void CHIP8::Tick()
 	{
+		if (mRecording != nullptr)
+		{
+			mRecording->events.push_back({mInstructionCount, InputRecording::Type::Tick, 0});
+		}
+		
+		// Lazy timers derive their value on read instead
+		if (mLazyTimers)
+		{
+			return;
+		}
+		
 		if (mDelayTimer > 0)
 		{
 			mDelayTimer--;
@@ -229,6 +860,22 @@ namespace emu
 		}
 	}
 	
+	void CHIP8::SetLazyTimers(bool lazy)
+	{
+		if (lazy == mLazyTimers)
+		{
+			return;
+		}
+		
+		// Materialise the current values under the old policy so switching
+		// doesn't jump either timer
+		mDelayTimer = DelayTimerValue();
+		mSoundTimer = SoundTimerValue();
+		mDelaySetAt = mInstructionCount;
+		mSoundSetAt = mInstructionCount;
+		mLazyTimers = lazy;
+	}
+	
 	void CHIP8::Dump() const
 	{
 		printf("CHIP-8 state:\n");
@@ -265,25 +912,97 @@ namespace emu
 	
 	bool CHIP8::NeedsRedraw() const
 	{
-		// Grab the base of the display data
-		const std::byte * displayData = &mRAM[kDisplayStart];
-		
-		// See if anything has changed
-		return std::memcmp(displayData, mDisplayBuffer.begin(), mDisplayBuffer.size()) != 0;
+		// The display-writing handlers track this for us
+		return mDisplayDirty;
 	}
 	
-	void CHIP8::Draw()
+	void CHIP8::MarkDisplayDirty(std::size_t firstRow, std::size_t lastRow)
+	{
+		mFramePending = true;
+		if (!mDisplayDirty)
+		{
+			mDisplayDirty = true;
+			mDirtyRowFirst = firstRow;
+			mDirtyRowLast = lastRow;
+		}
+		else
+		{
+			mDirtyRowFirst = std::min<uint8_t>(mDirtyRowFirst, firstRow);
+			mDirtyRowLast = std::max<uint8_t>(mDirtyRowLast, lastRow);
+		}
+	}
+	
+	void CHIP8::MarkDisplayBytesDirty(std::size_t start, std::size_t length)
+	{
+		// The lores display shares its bytes with RAM, so a store through I
+		// can poke pixels directly; pixels poked that way need a redraw just
+		// like ones drawn with Dxyn. The hires display lives outside of RAM
+		// and can't be hit.
+		if (mHires || start + length <= kDisplayStart || start >= kDisplayStart + kDisplaySize)
+		{
+			return;
+		}
+		
+		const std::size_t first = std::max<std::size_t>(start, kDisplayStart) - kDisplayStart;
+		const std::size_t last = std::min<std::size_t>(start + length, kDisplayStart + kDisplaySize) - kDisplayStart - 1;
+		MarkDisplayDirty(first / DisplayPitch(), last / DisplayPitch());
+	}
+	
+	void CHIP8::PublishFrame()
 	{
-		// Grab the base of the display data
-		const std::byte * displayData = &mRAM[kDisplayStart];
+		// Nothing drew since the last publish, so the front buffer and the
+		// generation a renderer saw are both still current
+		if (!mFramePending)
+		{
+			return;
+		}
+		mFramePending = false;
+		
+		// Classic seqlock write: bump to odd, copy, bump to even. A reader
+		// that overlaps the copy sees either the odd value or a changed
+		// sequence and retries.
+		const uint32_t seq = mFrameSeq.load(std::memory_order_relaxed);
+		mFrameSeq.store(seq + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		
+		std::memcpy(mFrontBuffer.data(), DisplayData(), DisplaySize());
+		
+		mFrameSeq.store(seq + 2, std::memory_order_release);
+	}
+	
+	uint32_t CHIP8::GetDisplayFrame(std::byte * dst, std::size_t size) const
+	{
+		const std::size_t toCopy = std::min(size, mFrontBuffer.size());
 		
-		// Update the cached buffer
-		std::memcpy(mDisplayBuffer.begin(), displayData, mDisplayBuffer.size());
+		while (true)
+		{
+			// Wait out an in-flight publish
+			const uint32_t before = mFrameSeq.load(std::memory_order_acquire);
+			if (before & 1)
+			{
+				continue;
+			}
+			
+			std::memcpy(dst, mFrontBuffer.data(), toCopy);
+			
+			// If the sequence moved, the copy may have mixed two frames
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (mFrameSeq.load(std::memory_order_relaxed) == before)
+			{
+				return before / 2;
+			}
+		}
+	}
+	
+	void TerminalFrameSink::OnFrame(const std::byte * packed, std::size_t size, std::size_t width, std::size_t height, uint64_t frame)
+	{
+		(void)size;
+		(void)frame;
 		
-		auto border = []()
+		auto border = [&]()
 		{
 			printf("+");
-			for (size_t x = 0; x < kDisplayWidth; x++)
+			for (size_t x = 0; x < width; x++)
 			{
 				printf("-");
 			}
@@ -292,13 +1011,13 @@ namespace emu
 		
 		// Print out the pixel display with a border
 		border();
-		for (size_t y = 0; y < kDisplayHeight; y++)
+		for (size_t y = 0; y < height; y++)
 		{
 			printf("|");
-			for (size_t x = 0; x < kDisplayWidth / 8; x++)
+			for (size_t x = 0; x < width / 8; x++)
 			{
 				// Since the pixels are encoded as bits we can read a byte and deal with that
-				uint8_t block = static_cast<uint8_t>(*displayData++);
+				uint8_t block = static_cast<uint8_t>(*packed++);
 				for (size_t i = 0; i < 8; i++)
 				{
 					const bool isSet = block & (1 << (7 - i));
@@ -310,15 +1029,242 @@ namespace emu
 		border();
 	}
 	
+	void FdFrameSink::OnFrame(const std::byte * packed, std::size_t size, std::size_t width, std::size_t height, uint64_t frame)
+	{
+		Header header;
+		header.frame = frame;
+		header.width = static_cast<uint16_t>(width);
+		header.height = static_cast<uint16_t>(height);
+		header.size = static_cast<uint32_t>(size);
+		
+		// Header and payload go out in one syscall
+		iovec parts[2];
+		parts[0].iov_base = &header;
+		parts[0].iov_len = sizeof(header);
+		parts[1].iov_base = const_cast<std::byte*>(packed);
+		parts[1].iov_len = size;
+		writev(mFd, parts, 2);
+	}
+	
+	void CHIP8::Draw()
+	{
+		// Grab the base of the active display's data
+		const std::byte * displayData = DisplayData();
+		const size_t pitch = DisplayPitch();
+		
+		// Update the cached buffer, but only the rows that actually changed
+		if (mDisplayDirty)
+		{
+			const size_t offset = mDirtyRowFirst * pitch;
+			const size_t end = std::min<size_t>((mDirtyRowLast + 1) * pitch, DisplaySize());
+			std::memcpy(mDisplayBuffer.begin() + offset, displayData + offset, end - offset);
+			mDisplayDirty = false;
+		}
+		
+		// Hand the frame to the attached sink, defaulting to the terminal
+		static TerminalFrameSink terminal;
+		FrameSink& sink = mFrameSink != nullptr ? *mFrameSink : terminal;
+		sink.OnFrame(displayData, DisplaySize(), DisplayWidth(), DisplayHeight(), mFrameCounter);
+		mFrameCounter++;
+	}
+	
+	void CHIP8::DrawInto(uint8_t* rgba)
+	{
+		const std::byte * displayData = DisplayData();
+		const size_t pitch = DisplayPitch();
+		
+		// Fold the changed rows into the cached buffer, same as Draw()
+		if (mDisplayDirty)
+		{
+			const size_t offset = mDirtyRowFirst * pitch;
+			const size_t end = std::min<size_t>((mDirtyRowLast + 1) * pitch, DisplaySize());
+			std::memcpy(mDisplayBuffer.begin() + offset, displayData + offset, end - offset);
+			mDisplayDirty = false;
+		}
+		
+		// Expand each packed byte to 8 RGBA pixels: spread its bits out to a
+		// byte each through the table, multiply each of those up to a 32-bit
+		// pixel, and store the pixels two at a time
+		for (size_t i = 0; i < pitch * DisplayHeight(); i++)
+		{
+			const uint8_t block = static_cast<uint8_t>(displayData[i]);
+			const uint64_t spread = kBitSpread[block];
+			
+			for (size_t j = 0; j < 8; j += 2)
+			{
+				const uint32_t first = 0x01010101u * static_cast<uint8_t>(spread >> (j * 8));
+				const uint32_t second = 0x01010101u * static_cast<uint8_t>(spread >> ((j + 1) * 8));
+				const uint64_t pixels = first | (static_cast<uint64_t>(second) << 32);
+				std::memcpy(rgba, &pixels, sizeof(pixels));
+				rgba += sizeof(pixels);
+			}
+		}
+	}
+	
+	bool CHIP8::GetChangedRows(std::size_t& firstRow, std::size_t& lastRow) const
+	{
+		if (!mDisplayDirty)
+		{
+			return false;
+		}
+		
+		const std::byte * displayData = DisplayData();
+		const size_t pitch = DisplayPitch();
+		
+		// The dirty range is conservative (a sprite that XORs pixels straight
+		// back off still marks its rows), so compare against the cached buffer
+		// to narrow it down to rows that really differ. Each row is a word or
+		// two of memcmp, which the compiler turns into register compares.
+		auto rowChanged = [&](size_t row)
+		{
+			const size_t offset = row * pitch;
+			const size_t size = std::min<size_t>(pitch, DisplaySize() - offset);
+			return std::memcmp(displayData + offset, &mDisplayBuffer[offset], size) != 0;
+		};
+		
+		size_t first = mDirtyRowFirst;
+		size_t last = std::min<size_t>(mDirtyRowLast, DisplayHeight() - 1);
+		
+		while (first <= last && !rowChanged(first))
+		{
+			first++;
+		}
+		while (last > first && !rowChanged(last))
+		{
+			last--;
+		}
+		
+		if (first > last)
+		{
+			return false;
+		}
+		
+		firstRow = first;
+		lastRow = last;
+		return true;
+	}
+	
+	
+	void CHIP8::DumpTrace() const
+	{
+		const uint64_t count = std::min<uint64_t>(mTraceCount, kTraceLength);
+		printf("Last %llu instructions:\n", static_cast<unsigned long long>(count));
+		
+		for (uint64_t i = mTraceCount - count; i < mTraceCount; i++)
+		{
+			const TraceRecord& record = mTrace[i & (kTraceLength - 1)];
+			printf("\t0x%03X: 0x%04X\tVx: V%X\n", record.pc, record.ins, (record.ins >> 8) & 0x0F);
+		}
+	}
 	
 	void CHIP8::OnError(const char* msg) const
 	{
-		// Dump the state of the emulator before throwing so we have a chance at seeing what's going on
+		// Dump the state of the emulator and the trace leading up to it
+		// before throwing so we have a chance at seeing what's going on
 		Dump();
+		DumpTrace();
 		throw std::runtime_error(msg);
 	}
 	
-	CHIP8::Instruction CHIP8::ReadInstruction()
+	uint8_t CHIP8::ResolveHandler(Instruction ins)
+	{
+		// This runs once per translated address, so the nested switches here
+		// are the last unpredictable branches left on the decode path; Step
+		// itself only ever makes one indirect call per instruction
+		switch (ins >> 12)
+		{
+			case 0x0:
+				switch (ins & 0x0FFF)
+				{
+					case 0x0E0:	return kHandler_Cls;
+					case 0x0EE:	return kHandler_Ret;
+					case 0x0FB:	return kHandler_ScrollRight;
+					case 0x0FC:	return kHandler_ScrollLeft;
+					case 0x0FD:	return kHandler_Exit;
+					case 0x0FE:	return kHandler_LoresMode;
+					case 0x0FF:	return kHandler_HiresMode;
+				}
+				if ((ins & 0x0FF0) == 0x00C0)
+				{
+					return kHandler_ScrollDown;
+				}
+				break;
+			
+			case 0x1:	return kHandler_Jump;
+			case 0x2:	return kHandler_Call;
+			case 0x3:	return kHandler_SkipEqualImm;
+			case 0x4:	return kHandler_SkipNotEqualImm;
+			
+			case 0x5:
+				if ((ins & 0x000F) == 0x0)
+				{
+					return kHandler_SkipEqual;
+				}
+				break;
+			
+			case 0x6:	return kHandler_SetImm;
+			case 0x7:	return kHandler_AddImm;
+			
+			case 0x8:
+				switch (ins & 0x000F)
+				{
+					case 0x0:	return kHandler_Set;
+					case 0x1:	return kHandler_Or;
+					case 0x2:	return kHandler_And;
+					case 0x3:	return kHandler_Xor;
+					case 0x4:	return kHandler_Add;
+					case 0x5:	return kHandler_Sub;
+					case 0x6:	return kHandler_ShiftRight;
+					case 0x7:	return kHandler_SubFrom;
+					case 0xE:	return kHandler_ShiftLeft;
+				}
+				break;
+			
+			case 0x9:
+				if ((ins & 0x000F) == 0x0)
+				{
+					return kHandler_SkipNotEqual;
+				}
+				break;
+			
+			case 0xA:	return kHandler_SetI;
+			case 0xB:	return kHandler_JumpV0;
+			case 0xC:	return kHandler_Random;
+			case 0xD:	return kHandler_Draw;
+			
+			case 0xE:
+				switch (ins & 0x00FF)
+				{
+					case 0x9E:	return kHandler_SkipKeyPressed;
+					case 0xA1:	return kHandler_SkipKeyNotPressed;
+				}
+				break;
+			
+			case 0xF:
+				switch (ins & 0x00FF)
+				{
+					case 0x07:	return kHandler_GetDelay;
+					case 0x0A:	return kHandler_WaitKey;
+					case 0x15:	return kHandler_SetDelay;
+					case 0x18:	return kHandler_SetSound;
+					case 0x1E:	return kHandler_AddI;
+					case 0x29:	return kHandler_CharacterSprite;
+					case 0x30:	return kHandler_BigCharacterSprite;
+					case 0x33:	return kHandler_StoreBCD;
+					case 0x55:	return kHandler_StoreRegisters;
+					case 0x65:	return kHandler_LoadRegisters;
+					case 0x75:	return kHandler_StoreUserFlags;
+					case 0x85:	return kHandler_LoadUserFlags;
+				}
+				break;
+		}
+		
+		// Leave the error for execution time so decoding ahead of an invalid
+		// encoding can't take the emulator down
+		return kHandler_Unknown;
+	}
+	
+	const CHIP8::DecodedOp& CHIP8::Decode()
 	{
 		// Check for overflow
 		if (mPC + sizeof(Instruction) >= mRAM.size())
@@ -326,15 +1272,70 @@ namespace emu
 			OnError("Program counter left RAM");
 		}
 		
-		// Read the instruction
-		Instruction ins;
-		memcpy(&ins, &mRAM[mPC], sizeof(ins));
-		ins = bswap(ins);
+		DecodedOp& op = mDecodeCache[mPC];
+		if (op.handler == kNotDecoded)
+		{
+			// First execution of this address, so translate it
+			Instruction ins;
+			memcpy(&ins, &mRAM[mPC], sizeof(ins));
+			op.ins = bswap(ins);
+			op.nnn = op.ins & 0x0FFF;
+			op.rx = (op.ins >> 8) & 0x0F;
+			op.ry = (op.ins >> 4) & 0x0F;
+			op.nn = (op.ins >> 0) & 0xFF;
+			op.n = (op.ins >> 0) & 0x0F;
+			op.handler = ResolveHandler(op.ins);
+		}
+		
+		// Remember if we're running code out of display RAM so that the
+		// display-writing handlers know to invalidate it
+		if (mPC >= kDisplayStart)
+		{
+			mDecodeInDisplay = true;
+		}
 		
 		// Update the PC
 		mPC += sizeof(Instruction);
 		
-		return ins;
+		return op;
+	}
+	
+	void CHIP8::InvalidateDecodeCache(std::size_t start, std::size_t length)
+	{
+		// An instruction starting one byte before the written range also
+		// overlaps it
+		const std::size_t first = start > 0 ? start - 1 : 0;
+		const std::size_t end = std::min(start + length, mDecodeCache.size());
+		
+		for (std::size_t i = first; i < end; i++)
+		{
+			mDecodeCache[i].handler = kNotDecoded;
+		}
+	}
+	
+	void CHIP8::InvalidateDisplayCode()
+	{
+		// The hires display lives outside of RAM so code can never run from
+		// it; only the lores display shares bytes with the decode cache
+		if (!mHires && mDecodeInDisplay)
+		{
+			InvalidateDecodeCache(kDisplayStart, kDisplaySize);
+			mDecodeInDisplay = false;
+		}
+	}
+	
+	void CHIP8::SetDisplayMode(bool hires)
+	{
+		if (hires == mHires)
+		{
+			return;
+		}
+		mHires = hires;
+		
+		// Switching modes starts from a blank display
+		std::memset(DisplayData(), 0, DisplaySize());
+		MarkDisplayDirty(0, DisplayHeight() - 1);
+		InvalidateDisplayCode();
 	}
 	
 	
@@ -346,66 +1347,134 @@ namespace emu
 		OnError(message);
 	}
 	
-	void CHIP8::Handle_0(Instruction ins)
+	void CHIP8::Handle_Cls(const DecodedOp&)
 	{
-		// Read off the program
-		const Address program = ins & 0x0FFF;
+		// Grab the base of the active display's data
+		std::byte * displayData = DisplayData();
 		
-		switch (program)
+		// Only flag a redraw if there was anything to clear
+		for (size_t i = 0; i < DisplaySize(); i++)
 		{
-			case 0x00E0:
+			if (displayData[i] != std::byte{0})
 			{
-				// Grab the base of the display data
-				std::byte * displayData = &mRAM[kDisplayStart];
-				
-				// Clear it all
-				std::memset(displayData, 0, kDisplaySize);
+				MarkDisplayDirty(0, DisplayHeight() - 1);
+				break;
 			}
-			break;
-			
-			
-			case 0x00EE:
+		}
+		
+		// Clear it all
+		std::memset(displayData, 0, DisplaySize());
+		
+		// If code has run from display RAM then its translations are stale
+		InvalidateDisplayCode();
+	}
+	
+	void CHIP8::Handle_ScrollDown(const DecodedOp& op)
+	{
+		const size_t rows = op.n;
+		if (rows == 0)
+		{
+			return;
+		}
+		
+		std::byte * displayData = DisplayData();
+		const size_t pitch = DisplayPitch();
+		
+		// Shuffle everything down and blank the rows scrolled in at the top
+		std::memmove(displayData + rows * pitch, displayData, DisplaySize() - rows * pitch);
+		std::memset(displayData, 0, rows * pitch);
+		
+		MarkDisplayDirty(0, DisplayHeight() - 1);
+		InvalidateDisplayCode();
+	}
+	
+	void CHIP8::Handle_ScrollRight(const DecodedOp&)
+	{
+		std::byte * displayData = DisplayData();
+		const size_t pitch = DisplayPitch();
+		
+		// Shift each row right by 4 pixels, carrying across byte boundaries
+		for (size_t y = 0; y < DisplayHeight(); y++)
+		{
+			uint8_t * row = reinterpret_cast<uint8_t*>(displayData + y * pitch);
+			uint8_t carry = 0;
+			for (size_t x = 0; x < pitch; x++)
 			{
-				// Pop the return address from the stack
-				if (mStack == 0)
-				{
-					OnError("Out of stack frames");
-				}
-				mStack--;
-				const Address address = mStackFrames[mStack];
-				
-				// Check the address hasn't been corrupted somehow
-				if (address >= mRAM.size())
-				{
-					OnError("Invalid address on stack");
-				}
-				
-				// Update PC
-				mPC = address;
+				const uint8_t block = row[x];
+				row[x] = (block >> 4) | carry;
+				carry = block << 4;
+			}
+		}
+		
+		MarkDisplayDirty(0, DisplayHeight() - 1);
+		InvalidateDisplayCode();
+	}
+	
+	void CHIP8::Handle_ScrollLeft(const DecodedOp&)
+	{
+		std::byte * displayData = DisplayData();
+		const size_t pitch = DisplayPitch();
+		
+		// Shift each row left by 4 pixels, pulling across byte boundaries
+		for (size_t y = 0; y < DisplayHeight(); y++)
+		{
+			uint8_t * row = reinterpret_cast<uint8_t*>(displayData + y * pitch);
+			for (size_t x = 0; x < pitch; x++)
+			{
+				const uint8_t next = x + 1 < pitch ? row[x + 1] : 0;
+				row[x] = (row[x] << 4) | (next >> 4);
 			}
-			break;
-			
-			
-			default:
-				Unhandled(ins);
-				break;
 		}
+		
+		MarkDisplayDirty(0, DisplayHeight() - 1);
+		InvalidateDisplayCode();
+	}
+	
+	void CHIP8::Handle_Exit(const DecodedOp&)
+	{
+		// Park the PC on this instruction so a dump shows where we stopped
+		mHalted = true;
+		mPC -= sizeof(Instruction);
+	}
+	
+	void CHIP8::Handle_LoresMode(const DecodedOp&)
+	{
+		SetDisplayMode(false);
+	}
+	
+	void CHIP8::Handle_HiresMode(const DecodedOp&)
+	{
+		SetDisplayMode(true);
 	}
 	
-	void CHIP8::Handle_1(Instruction ins)
+	void CHIP8::Handle_Ret(const DecodedOp&)
 	{
-		// Read off the address
-		const Address address = ins & 0x0FFF;
+		// Pop the return address from the stack
+		if (mStack == 0)
+		{
+			OnError("Out of stack frames");
+		}
+		mStack--;
+		const Address address = mStackFrames[mStack];
+		
+		// Check the address hasn't been corrupted somehow
+		if (address >= mRAM.size())
+		{
+			OnError("Invalid address on stack");
+		}
 		
 		// Update PC
 		mPC = address;
 	}
 	
-	void CHIP8::Handle_2(Instruction ins)
+	void CHIP8::Handle_Jump(const DecodedOp& op)
+	{
+		// Update PC
+		mPC = op.nnn;
+	}
+	
+	void CHIP8::Handle_Call(const DecodedOp& op)
 	{
-		// Read off the address
-		const Address address = ins & 0x0FFF;
-		
 		// Push the current return address onto the stack
 		if (mStack + 1 > mStackFrames.size())
 		{
@@ -415,441 +1484,446 @@ namespace emu
 		mStack++;
 		
 		// Update PC
-		mPC = address;
+		mPC = op.nnn;
 	}
 	
-	void CHIP8::Handle_3(Instruction ins)
+	void CHIP8::Handle_SkipEqualImm(const DecodedOp& op)
 	{
-		// Read off the register and value
-		const uint8_t reg = (ins >> 8) & 0x0F;
-		const uint8_t val = (ins >> 0) & 0xFF;
-		
-		if (mRegisters[reg] == val)
+		if (mRegisters[op.rx] == op.nn)
 		{
 			// Skip an instruction
-			if (mPC + sizeof(Instruction) >= mRAM.size())
-			{
-				OnError("Branching outside of RAM");
-			}
-			mPC += sizeof(Instruction);
+			mPC = CheckedAddress(mPC + sizeof(Instruction), "Branching outside of RAM");
 		}
 	}
 	
-	void CHIP8::Handle_4(Instruction ins)
+	void CHIP8::Handle_SkipNotEqualImm(const DecodedOp& op)
 	{
-		// Read off the register and value
-		const uint8_t reg = (ins >> 8) & 0x0F;
-		const uint8_t val = (ins >> 0) & 0xFF;
-		
-		if (mRegisters[reg] != val)
+		if (mRegisters[op.rx] != op.nn)
 		{
 			// Skip an instruction
-			if (mPC + sizeof(Instruction) >= mRAM.size())
-			{
-				OnError("Branching outside of RAM");
-			}
-			mPC += sizeof(Instruction);
+			mPC = CheckedAddress(mPC + sizeof(Instruction), "Branching outside of RAM");
 		}
 	}
 	
-	void CHIP8::Handle_5(Instruction ins)
+	void CHIP8::Handle_SkipEqual(const DecodedOp& op)
 	{
-		// Read off the registers and op
-		const uint8_t rx = (ins >> 8) & 0x0F;
-		const uint8_t ry = (ins >> 4) & 0x0F;
-		const uint8_t op = (ins >> 0) & 0x0F;
-		
-		const uint8_t x = mRegisters[rx];
-		const uint8_t y = mRegisters[ry];
-		
-		switch (op)
+		if (mRegisters[op.rx] == mRegisters[op.ry])
 		{
-			case 0x0:
-			{
-				if (x == y)
-				{
-					// Skip an instruction
-					if (mPC + sizeof(Instruction) >= mRAM.size())
-					{
-						OnError("Branching outside of RAM");
-					}
-					mPC += sizeof(Instruction);
-				}
-			}
-			break;
-			
-			default:
-				Unhandled(ins);
-				break;
+			// Skip an instruction
+			mPC = CheckedAddress(mPC + sizeof(Instruction), "Branching outside of RAM");
 		}
 	}
 	
-	void CHIP8::Handle_6(Instruction ins)
+	void CHIP8::Handle_SetImm(const DecodedOp& op)
 	{
-		// Read off the register and value
-		const uint8_t reg = (ins >> 8) & 0x0F;
-		const uint8_t val = (ins >> 0) & 0xFF;
-		
 		// Update the register
-		mRegisters[reg] = val;
+		mRegisters[op.rx] = op.nn;
 	}
 	
-	void CHIP8::Handle_7(Instruction ins)
+	void CHIP8::Handle_AddImm(const DecodedOp& op)
 	{
-		// Read off the register and value
-		const uint8_t reg = (ins >> 8) & 0x0F;
-		const uint8_t val = (ins >> 0) & 0xFF;
-		
 		// Update the register
-		mRegisters[reg] += val;
+		mRegisters[op.rx] += op.nn;
 	}
 	
-	void CHIP8::Handle_8(Instruction ins)
+	void CHIP8::Handle_Set(const DecodedOp& op)
 	{
-		// Read off the registers and op
-		const uint8_t rx = (ins >> 8) & 0x0F;
-		const uint8_t ry = (ins >> 4) & 0x0F;
-		const uint8_t op = (ins >> 0) & 0x0F;
-		
-		uint8_t& x = mRegisters[rx];
-		const uint8_t y = mRegisters[ry];
+		mRegisters[op.rx] = mRegisters[op.ry];
+	}
+	
+	void CHIP8::Handle_Or(const DecodedOp& op)
+	{
+		mRegisters[op.rx] |= mRegisters[op.ry];
+	}
+	
+	void CHIP8::Handle_And(const DecodedOp& op)
+	{
+		mRegisters[op.rx] &= mRegisters[op.ry];
+	}
+	
+	void CHIP8::Handle_Xor(const DecodedOp& op)
+	{
+		mRegisters[op.rx] ^= mRegisters[op.ry];
+	}
+	
+	void CHIP8::Handle_Add(const DecodedOp& op)
+	{
+		if (op.rx == 0xF || op.ry == 0xF) OnError("Ordering");
+		uint8_t& x = mRegisters[op.rx];
+		const uint8_t y = mRegisters[op.ry];
 		
-		switch (op)
-		{
-			case 0x0:	x  = y;		break;
-			case 0x1:	x |= y;		break;
-			case 0x2:	x &= y;		break;
-			case 0x3:	x ^= y;		break;
-			
-			case 0x4:
-			{
-				if (rx == 0xF || ry == 0xF) OnError("Ordering");
-				const bool carry = x + y > 0xFF;
-				x += y;
-				mRegisters[0xF] = carry ? 1 : 0;
-			}
-			break;
-			
-			case 0x5:
-			{
-				if (rx == 0xF || ry == 0xF) OnError("Ordering");
-				const bool borrow = x < y;
-				x -= y;
-				mRegisters[0xF] = borrow ? 0 : 1;
-			}
-			break;
-			
-			case 0x7:
-			{
-				if (rx == 0xF || ry == 0xF) OnError("Ordering");
-				const bool borrow = y < x;
-				x = y - x;
-				mRegisters[0xF] = borrow ? 0 : 1;
-			}
-			break;
-			
-			
-			case 0x6:
-				if (rx == 0xF || ry == 0xF) OnError("Ordering");
-				mRegisters[0xF] = (x >> 0) & 1;
-				x >>= 1;
-				break;
-			
-			case 0xE:
-				if (rx == 0xF || ry == 0xF) OnError("Ordering");
-				mRegisters[0xF] = (x >> 7) & 1;
-				x <<= 1;
-				break;
-			
-			
-			default:
-				Unhandled(ins);
-				break;
-		}
+		const bool carry = x + y > 0xFF;
+		x += y;
+		mRegisters[0xF] = carry ? 1 : 0;
 	}
 	
-	void CHIP8::Handle_9(Instruction ins)
+	void CHIP8::Handle_Sub(const DecodedOp& op)
 	{
-		// Read off the registers and op
-		const uint8_t rx = (ins >> 8) & 0x0F;
-		const uint8_t ry = (ins >> 4) & 0x0F;
-		const uint8_t op = (ins >> 0) & 0x0F;
+		if (op.rx == 0xF || op.ry == 0xF) OnError("Ordering");
+		uint8_t& x = mRegisters[op.rx];
+		const uint8_t y = mRegisters[op.ry];
 		
-		const uint8_t x = mRegisters[rx];
-		const uint8_t y = mRegisters[ry];
+		const bool borrow = x < y;
+		x -= y;
+		mRegisters[0xF] = borrow ? 0 : 1;
+	}
+	
+	void CHIP8::Handle_ShiftRight(const DecodedOp& op)
+	{
+		if (op.rx == 0xF || op.ry == 0xF) OnError("Ordering");
+		uint8_t& x = mRegisters[op.rx];
 		
-		switch (op)
-		{
-			case 0x0:
-			{
-				if (x != y)
-				{
-					// Skip an instruction
-					if (mPC + sizeof(Instruction) >= mRAM.size())
-					{
-						OnError("Branching outside of RAM");
-					}
-					mPC += sizeof(Instruction);
-				}
-			}
-			break;
-			
-			default:
-				Unhandled(ins);
-				break;
-		}
+		mRegisters[0xF] = (x >> 0) & 1;
+		x >>= 1;
 	}
 	
-	void CHIP8::Handle_A(Instruction ins)
+	void CHIP8::Handle_SubFrom(const DecodedOp& op)
 	{
-		// Read off the address
-		const Address address = ins & 0x0FFF;
+		if (op.rx == 0xF || op.ry == 0xF) OnError("Ordering");
+		uint8_t& x = mRegisters[op.rx];
+		const uint8_t y = mRegisters[op.ry];
 		
-		// Update I
-		mI = address;
+		const bool borrow = y < x;
+		x = y - x;
+		mRegisters[0xF] = borrow ? 0 : 1;
 	}
 	
-	void CHIP8::Handle_B(Instruction ins)
+	void CHIP8::Handle_ShiftLeft(const DecodedOp& op)
 	{
-		// Read off the address
-		const Address address = ins & 0x0FFF;
+		if (op.rx == 0xF || op.ry == 0xF) OnError("Ordering");
+		uint8_t& x = mRegisters[op.rx];
 		
-		if (mRegisters[0] + address > mRAM.size())
+		mRegisters[0xF] = (x >> 7) & 1;
+		x <<= 1;
+	}
+	
+	void CHIP8::Handle_SkipNotEqual(const DecodedOp& op)
+	{
+		if (mRegisters[op.rx] != mRegisters[op.ry])
 		{
-			OnError("Trying to jump out of RAM");
+			// Skip an instruction
+			mPC = CheckedAddress(mPC + sizeof(Instruction), "Branching outside of RAM");
 		}
-		
+	}
+	
+	void CHIP8::Handle_SetI(const DecodedOp& op)
+	{
+		// Update I
+		mI = op.nnn;
+	}
+	
+	void CHIP8::Handle_JumpV0(const DecodedOp& op)
+	{
 		// Update PC
-		mPC = mRegisters[0] + address;
+		mPC = CheckedAddress(mRegisters[0] + op.nnn, "Trying to jump out of RAM");
 	}
 	
-	void CHIP8::Handle_C(Instruction ins)
+	void CHIP8::Handle_Random(const DecodedOp& op)
 	{
-		// Read off the register and value
-		const uint8_t reg = (ins >> 8) & 0x0F;
-		const uint8_t max = (ins >> 0) & 0xFF;
-		
 		// Generate the random number
-		const uint8_t val = rand() & max;
+		const uint8_t val = NextRandom() & op.nn;
 		
 		// Update the register
-		mRegisters[reg] = val;
+		mRegisters[op.rx] = val;
 	}
 	
-	void CHIP8::Handle_D(Instruction ins)
+	void CHIP8::Handle_Draw(const DecodedOp& op)
 	{
-		// Read off VX, VY, and N
-		const uint8_t vx = (ins >> 8) & 0x0F;
-		const uint8_t vy = (ins >> 4) & 0x0F;
-		const size_t n   = (ins >> 0) & 0x0F;
+		// Dxy0 in hires mode draws a 16x16 sprite; everything else is 8 wide
+		const bool wide = mHires && op.n == 0;
+		const size_t n = wide ? 16 : op.n;
+		const size_t spriteWidth = wide ? 16 : 8;
+		const size_t srcPitch = wide ? 2 : 1;
 		
 		// Read X and Y from the registers
-		const size_t baseX = mRegisters[vx];
-		const size_t baseY = mRegisters[vy];
+		const size_t baseX = mRegisters[op.rx];
+		const size_t baseY = mRegisters[op.ry];
 		
-		// Grab the base of the display data
-		uint8_t * displayData = reinterpret_cast<uint8_t*>(&mRAM[kDisplayStart]);
+		// Grab the active display's geometry
+		uint8_t * displayData = reinterpret_cast<uint8_t*>(DisplayData());
+		const size_t width = DisplayWidth();
+		const size_t height = DisplayHeight();
+		const size_t pitch = width / 8;
 		
 		// Grab the base of where we're blitting from
 		const uint8_t * srcData = reinterpret_cast<uint8_t*>(&mRAM[mI]);
 		
 		// Sanity check where we're blitting from
-		if (mI + n >= mRAM.size())
+		if (mI + n * srcPitch >= mRAM.size())
 		{
 			OnError("Blitting from outside of RAM");
 		}
 		
+		// Work out where in a row the sprite starts
+		const size_t startX = baseX % width;
+		const size_t xByte = startX / 8;
+		const size_t bitOffset = startX % 8;
+		const size_t span = spriteWidth / 8 + (bitOffset != 0 ? 1 : 0);
+		
 		// Do the blit
 		bool flippedOff = false;
-		for (size_t srcY = 0; srcY < n; srcY++)
+		if (xByte + span <= pitch)
 		{
-			for (size_t srcX = 0; srcX < 8; srcX++)
+			// Fast path: the sprite pixels land in adjacent bytes of the same
+			// display row, so each row is one shifted XOR through a 32-bit
+			// window and collisions fall out of a single AND
+			for (size_t srcY = 0; srcY < n; srcY++)
 			{
 				// Out of bounds wraps
-				const size_t dispX = (srcX + baseX) % kDisplayWidth;
-				const size_t dispY = (srcY + baseY) % kDisplayHeight;
-				
-				// Calculate where in memory we need to blit to
-				const size_t pixelNum = dispY * kDisplayWidth + dispX;
-				const size_t pixelBlockNum = pixelNum / 8;
+				const size_t dispY = (srcY + baseY) % height;
+				uint8_t * row = displayData + dispY * pitch;
 				
-				// Pixels are backwards, ie highest bit comes first
-				const size_t pixelBlockBit = 7 - (pixelNum - 8 * pixelBlockNum);
-				
-				// Read the destination block
-				uint8_t dstBlock = displayData[pixelBlockNum];
+				// Build 32-bit windows over the source and destination
+				uint32_t bits = srcData[srcY * srcPitch];
+				if (wide)
+				{
+					bits = (bits << 8) | srcData[srcY * srcPitch + 1];
+				}
+				const uint32_t src = bits << (32 - spriteWidth - bitOffset);
 				
-				// Read the relevant src bit
-				const bool srcBit = *srcData & (1 << (7 - srcX));
+				// XORing with anything non-zero always changes pixels
+				if (src != 0)
+				{
+					MarkDisplayDirty(dispY, dispY);
+				}
+				uint32_t dst = 0;
+				for (size_t k = 0; k < span; k++)
+				{
+					dst |= static_cast<uint32_t>(row[xByte + k]) << (24 - 8 * k);
+				}
 				
 				// Raise the flag if required
-				const bool dstBit = dstBlock & (1 << pixelBlockBit);
-				if (srcBit && dstBit)
+				if (dst & src)
 				{
 					flippedOff = true;
 				}
 				
-				// Flip the pixel
-				dstBlock ^= (srcBit ? 1 : 0) << pixelBlockBit;
-				
-				// Save it back
-				displayData[pixelBlockNum] = dstBlock;
+				// Flip the pixels and save them back
+				dst ^= src;
+				for (size_t k = 0; k < span; k++)
+				{
+					row[xByte + k] = (dst >> (24 - 8 * k)) & 0xFF;
+				}
 			}
-			
-			srcData++;
 		}
-		
-		// Store the result of the flips in VF
-		mRegisters[0xF] = flippedOff ? 1 : 0;
-	}
-	
-	void CHIP8::Handle_E(Instruction ins)
-	{
-		// Read off the register and op
-		const uint8_t reg = (ins >> 8) & 0x0F;
-		const uint8_t op  = (ins >> 0) & 0xFF;
-		
-		uint8_t& val = mRegisters[reg];
-		
-		switch (op)
+		else
 		{
-			case 0x9E:
+			// Slow path: the sprite wraps around the right edge of the display
+			for (size_t srcY = 0; srcY < n; srcY++)
 			{
-				if (val >= mKeyboard.size())
+				uint32_t bits = srcData[srcY * srcPitch];
+				if (wide)
 				{
-					OnError("Invalid key code requested");
+					bits = (bits << 8) | srcData[srcY * srcPitch + 1];
 				}
 				
-				if (mKeyboard[val])
+				// XORing with anything non-zero always changes pixels
+				if (bits != 0)
 				{
-					// Skip the next instruction
-					mPC += sizeof(Instruction);
-				}
-			}
-			break;
-			
-			case 0xA1:
-			{
-				if (val >= mKeyboard.size())
-				{
-					OnError("Invalid key code requested");
+					MarkDisplayDirty((srcY + baseY) % height, (srcY + baseY) % height);
 				}
 				
-				if (!mKeyboard[val])
+				for (size_t srcX = 0; srcX < spriteWidth; srcX++)
 				{
-					// Skip the next instruction
-					mPC += sizeof(Instruction);
+					// Out of bounds wraps
+					const size_t dispX = (srcX + baseX) % width;
+					const size_t dispY = (srcY + baseY) % height;
+					
+					// Calculate where in memory we need to blit to
+					const size_t pixelNum = dispY * width + dispX;
+					const size_t pixelBlockNum = pixelNum / 8;
+					
+					// Pixels are backwards, ie highest bit comes first
+					const size_t pixelBlockBit = 7 - (pixelNum - 8 * pixelBlockNum);
+					
+					// Read the destination block
+					uint8_t dstBlock = displayData[pixelBlockNum];
+					
+					// Read the relevant src bit
+					const bool srcBit = bits & (1u << (spriteWidth - 1 - srcX));
+					
+					// Raise the flag if required
+					const bool dstBit = dstBlock & (1 << pixelBlockBit);
+					if (srcBit && dstBit)
+					{
+						flippedOff = true;
+					}
+					
+					// Flip the pixel
+					dstBlock ^= (srcBit ? 1 : 0) << pixelBlockBit;
+					
+					// Save it back
+					displayData[pixelBlockNum] = dstBlock;
 				}
 			}
-			break;
-			
-			
-			default:
-				Unhandled(ins);
-				break;
 		}
+		
+		// If code has run from display RAM then its translations are stale
+		InvalidateDisplayCode();
+		
+		// Store the result of the flips in VF
+		mRegisters[0xF] = flippedOff ? 1 : 0;
 	}
 	
-	void CHIP8::Handle_F(Instruction ins)
+	void CHIP8::Handle_SkipKeyPressed(const DecodedOp& op)
 	{
-		// Read off the register and op
-		const uint8_t reg = (ins >> 8) & 0x0F;
-		const uint8_t op  = (ins >> 0) & 0xFF;
+		const uint8_t val = mRegisters[op.rx];
 		
-		uint8_t& val = mRegisters[reg];
+		if (val >= mKeyboard.size())
+		{
+			OnError("Invalid key code requested");
+		}
 		
-		switch (op)
+		if (mKeyboard[val])
 		{
-			case 0x07:
-			{
-				val = mDelayTimer;
-			}
-			break;
-			
-			case 0x0A:
-			{
-				// Save the register we want the key press to be saved to.
-				// This will be handled on the next call to Step().
-				mKeyboardRegister = reg;
-			}
-			break;
-			
-			case 0x15:
-			{
-				mDelayTimer = val;
-			}
-			break;
-			
-			case 0x18:
-			{
-				mSoundTimer = val;
-			}
-			break;
-			
-			
-			case 0x1E:
-			{
-				if (mI + val > mRAM.size())
-				{
-					OnError("Moving I to outside of RAM");
-				}
-				mI += val;
-			}
-			break;
-			
-			
-			case 0x29:
-			{
-				if (val >= 16)
-				{
-					OnError("Unknown key");
-				}
-				
-				// Each sprite is 5 lines long
-				mI = kCharacterSpritesStart + val * 5;
-			}
-			break;
-			
-			
-			case 0x33:
-			{
-				if (mI + 3 > mRAM.size())
-				{
-					OnError("Storing to I outside of RAM");
-				}
-				auto * ptr = reinterpret_cast<uint8_t*>(&mRAM[mI]);
-				
-				ptr[0] = (val / 100) % 10;
-				ptr[1] = (val /  10) % 10;
-				ptr[2] = (val /   1) % 10;
-			}
-			break;
-			
-			
-			case 0x55:
-			{
-				if (mI + reg > mRAM.size())
-				{
-					OnError("Copying to I outside of RAM");
-				}
-				std::memcpy(&mRAM[mI], &mRegisters[0], reg + 1);
-			}
-			break;
-			
-			case 0x65:
-			{
-				if (mI + reg > mRAM.size())
-				{
-					OnError("Copying from I outside of RAM");
-				}
-				std::memcpy(&mRegisters[0], &mRAM[mI], reg + 1);
-			}
-			break;
-			
-			
-			default:
-				Unhandled(ins);
-				break;
+			// Skip the next instruction
+			mPC += sizeof(Instruction);
+		}
+	}
+	
+	void CHIP8::Handle_SkipKeyNotPressed(const DecodedOp& op)
+	{
+		const uint8_t val = mRegisters[op.rx];
+		
+		if (val >= mKeyboard.size())
+		{
+			OnError("Invalid key code requested");
+		}
+		
+		if (!mKeyboard[val])
+		{
+			// Skip the next instruction
+			mPC += sizeof(Instruction);
 		}
 	}
+	
+	void CHIP8::Handle_GetDelay(const DecodedOp& op)
+	{
+		mRegisters[op.rx] = DelayTimerValue();
+	}
+	
+	void CHIP8::Handle_WaitKey(const DecodedOp& op)
+	{
+		// Save the register we want the key press to be saved to.
+		// This will be handled on the next call to Step().
+		mKeyboardRegister = op.rx;
+	}
+	
+	void CHIP8::Handle_SetDelay(const DecodedOp& op)
+	{
+		mDelayTimer = mRegisters[op.rx];
+		mDelaySetAt = mInstructionCount;
+	}
+	
+	void CHIP8::Handle_SetSound(const DecodedOp& op)
+	{
+		mSoundTimer = mRegisters[op.rx];
+		mSoundSetAt = mInstructionCount;
+	}
+	
+	void CHIP8::Handle_AddI(const DecodedOp& op)
+	{
+		const uint8_t val = mRegisters[op.rx];
+		
+		mI = CheckedAddress(mI + val, "Moving I to outside of RAM");
+	}
+	
+	void CHIP8::Handle_CharacterSprite(const DecodedOp& op)
+	{
+		const uint8_t val = mRegisters[op.rx];
+		
+		if (val >= 16)
+		{
+			OnError("Unknown key");
+		}
+		
+		// Each sprite is 5 lines long
+		mI = kCharacterSpritesStart + val * 5;
+	}
+	
+	void CHIP8::Handle_BigCharacterSprite(const DecodedOp& op)
+	{
+		const uint8_t val = mRegisters[op.rx];
+		
+		// Only the digits have big sprites
+		if (val >= 10)
+		{
+			OnError("Unknown big character");
+		}
+		
+		// Each big sprite is 10 lines long
+		mI = kBigCharacterSpritesStart + val * 10;
+	}
+	
+	void CHIP8::Handle_StoreBCD(const DecodedOp& op)
+	{
+		const uint8_t val = mRegisters[op.rx];
+		
+		if (mI + 3 > mRAM.size())
+		{
+			OnError("Storing to I outside of RAM");
+		}
+		auto * ptr = reinterpret_cast<uint8_t*>(&mRAM[mI]);
+		
+		ptr[0] = (val / 100) % 10;
+		ptr[1] = (val /  10) % 10;
+		ptr[2] = (val /   1) % 10;
+		
+		// The stores may have hit translated code, or the display
+		InvalidateDecodeCache(mI, 3);
+		MarkDisplayBytesDirty(mI, 3);
+	}
+	
+	void CHIP8::Handle_StoreRegisters(const DecodedOp& op)
+	{
+		const uint8_t reg = op.rx;
+		
+		if (mI + reg > mRAM.size())
+		{
+			OnError("Copying to I outside of RAM");
+		}
+		std::memcpy(&mRAM[mI], &mRegisters[0], reg + 1);
+		
+		// The stores may have hit translated code, or the display
+		InvalidateDecodeCache(mI, reg + 1);
+		MarkDisplayBytesDirty(mI, reg + 1);
+	}
+	
+	void CHIP8::Handle_LoadRegisters(const DecodedOp& op)
+	{
+		const uint8_t reg = op.rx;
+		
+		if (mI + reg > mRAM.size())
+		{
+			OnError("Copying from I outside of RAM");
+		}
+		std::memcpy(&mRegisters[0], &mRAM[mI], reg + 1);
+	}
+	
+	void CHIP8::Handle_StoreUserFlags(const DecodedOp& op)
+	{
+		const uint8_t reg = op.rx;
+		
+		if (reg >= mUserFlags.size())
+		{
+			OnError("Too many user flags");
+		}
+		std::copy(mRegisters.begin(), mRegisters.begin() + reg + 1, mUserFlags.begin());
+	}
+	
+	void CHIP8::Handle_LoadUserFlags(const DecodedOp& op)
+	{
+		const uint8_t reg = op.rx;
+		
+		if (reg >= mUserFlags.size())
+		{
+			OnError("Too many user flags");
+		}
+		std::copy(mUserFlags.begin(), mUserFlags.begin() + reg + 1, mRegisters.begin());
+	}
+	
+	void CHIP8::Handle_Unknown(const DecodedOp& op)
+	{
+		Unhandled(op.ins);
+	}
 }
@@ -6,17 +6,254 @@
 #include <vector>
 #include <array>
 #include <bitset>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <atomic>
 
 namespace emu
 {
 	class ROM
 	{
+	public:
+		ROM() = default;
+		~ROM();
+		
+		// The mapping can't be shared, so neither can the ROM
+		ROM(const ROM&) = delete;
+		ROM& operator=(const ROM&) = delete;
+		ROM(ROM&& other) noexcept;
+		ROM& operator=(ROM&& other) noexcept;
+	
 	public:
 		bool Load(const void * data, std::size_t size);
-		const auto& GetData() const { return mData; }
 		
+		// Memory-map the file rather than copying it through a buffer
+		bool LoadFile(const char * path);
+		
+		const std::byte * Data() const { return mMapped != nullptr ? mMapped : mData.data(); }
+		std::size_t Size() const { return mMapped != nullptr ? mMappedSize : mData.size(); }
+	
+	public:
+		// What an ahead-of-time walk of the reachable code found, so loaders
+		// can reject a broken ROM up front instead of minutes into a run, and
+		// decode/analysis passes can reuse the control-flow metadata
+		struct Analysis
+		{
+			bool valid;				// no reachable unknown opcode
+			uint16_t firstInvalid;	// address of the first one when !valid
+			std::vector<uint16_t> blockStarts;		// basic-block leaders, sorted
+			std::vector<uint16_t> spriteAddresses;	// distinct Annn targets, sorted
+			bool usesSelfModifyingCode;	// a reachable store can overlap reachable code
+		};
+		
+		// Walk every statically reachable instruction from the given entry
+		// address (see CHIP8::EntryPoint). Dynamic jumps (Bnnn) and code
+		// outside the image end a path rather than failing it.
+		Analysis Analyze(std::size_t entryPoint) const;
+	
+	private:
+		void Unmap();
+	
 	private:
 		std::vector<std::byte> mData;
+		const std::byte * mMapped = nullptr;
+		std::size_t mMappedSize = 0;
+	};
+	
+	
+	namespace detail
+	{
+		// Where the built-in character sprites live in RAM
+		inline constexpr uint16_t kCharacterSpritesStart = 0x0010;
+		
+		// 5-line sprites for each of the 16 characters. These live in the
+		// header so compile-time machine images can bake them in.
+		inline constexpr uint8_t kCharacterSprites[5 * 16] = {
+			// 0
+			0b11110000,
+			0b10010000,
+			0b10010000,
+			0b10010000,
+			0b11110000,
+			
+			// 1
+			0b01100000,
+			0b10100000,
+			0b00100000,
+			0b00100000,
+			0b11110000,
+			
+			// 2
+			0b11110000,
+			0b00010000,
+			0b11110000,
+			0b10000000,
+			0b11110000,
+			
+			// 3
+			0b11110000,
+			0b00010000,
+			0b11110000,
+			0b00010000,
+			0b11110000,
+			
+			// 4
+			0b10010000,
+			0b10010000,
+			0b11110000,
+			0b00010000,
+			0b00010000,
+			
+			// 5
+			0b11110000,
+			0b10000000,
+			0b11110000,
+			0b00010000,
+			0b11110000,
+			
+			// 6
+			0b11110000,
+			0b10000000,
+			0b11110000,
+			0b10010000,
+			0b11110000,
+			
+			// 7
+			0b11110000,
+			0b00010000,
+			0b00010000,
+			0b00010000,
+			0b00010000,
+			
+			// 8
+			0b11110000,
+			0b10010000,
+			0b11110000,
+			0b10010000,
+			0b11110000,
+			
+			// 9
+			0b11110000,
+			0b10010000,
+			0b11110000,
+			0b00010000,
+			0b00010000,
+			
+			// A
+			0b11110000,
+			0b10010000,
+			0b11110000,
+			0b10010000,
+			0b10010000,
+			
+			// B
+			0b11100000,
+			0b10010000,
+			0b11100000,
+			0b10010000,
+			0b11100000,
+			
+			// C
+			0b11110000,
+			0b10000000,
+			0b10000000,
+			0b10000000,
+			0b11110000,
+			
+			// D
+			0b11100000,
+			0b10010000,
+			0b10010000,
+			0b10010000,
+			0b11100000,
+			
+			// E
+			0b11110000,
+			0b10000000,
+			0b11110000,
+			0b10000000,
+			0b11110000,
+			
+			// F
+			0b11110000,
+			0b10000000,
+			0b11110000,
+			0b10000000,
+			0b10000000,
+		};
+		
+		// Where the SCHIP 8x10 digit sprites live in RAM
+		inline constexpr uint16_t kBigCharacterSpritesStart = 0x0060;
+		
+		// The big digits are the 4x5 font pixel-doubled in both directions
+		constexpr std::array<uint8_t, 10 * 10> MakeBigCharacterSprites()
+		{
+			std::array<uint8_t, 10 * 10> table{};
+			for (size_t digit = 0; digit < 10; digit++)
+			{
+				for (size_t row = 0; row < 5; row++)
+				{
+					const uint8_t line = kCharacterSprites[digit * 5 + row];
+					uint8_t wide = 0;
+					for (size_t bit = 0; bit < 4; bit++)
+					{
+						if (line & (0x80 >> bit))
+						{
+							wide |= 0xC0 >> (bit * 2);
+						}
+					}
+					table[digit * 10 + row * 2 + 0] = wide;
+					table[digit * 10 + row * 2 + 1] = wide;
+				}
+			}
+			return table;
+		}
+		
+		inline constexpr std::array<uint8_t, 10 * 10> kBigCharacterSprites = MakeBigCharacterSprites();
+	}
+	
+	
+	// Receives completed frames from CHIP8::Draw(). The packed buffer is the
+	// display's native layout: row-major, one bit per pixel, MSB first.
+	class FrameSink
+	{
+	public:
+		virtual ~FrameSink() = default;
+		
+		virtual void OnFrame(const std::byte * packed, std::size_t size, std::size_t width, std::size_t height, uint64_t frame) = 0;
+	};
+	
+	
+	// The bordered ASCII renderer, as one sink among others
+	class TerminalFrameSink : public FrameSink
+	{
+	public:
+		void OnFrame(const std::byte * packed, std::size_t size, std::size_t width, std::size_t height, uint64_t frame) override;
+	};
+	
+	
+	// Streams each frame as a fixed header plus the packed payload in a
+	// single writev(2), for piping into a collector instead of a terminal
+	class FdFrameSink : public FrameSink
+	{
+	public:
+		explicit FdFrameSink(int fd) : mFd{fd} {}
+		
+		void OnFrame(const std::byte * packed, std::size_t size, std::size_t width, std::size_t height, uint64_t frame) override;
+		
+		// What precedes each frame's payload on the stream
+		struct Header
+		{
+			uint64_t frame;
+			uint16_t width;
+			uint16_t height;
+			uint32_t size;	// payload bytes that follow
+		};
+	
+	private:
+		int mFd;
 	};
 	
 	
@@ -27,23 +264,228 @@ namespace emu
 		{
 			CHIP8,
 			ETI660,
+			SCHIP,
 		};
 		
 		using KeyboardState = std::bitset<16>;
+		using Clock = std::chrono::steady_clock;
+		
+		// Where each type of program starts executing
+		static constexpr uint16_t EntryPoint(Program type)
+		{
+			return type == Program::ETI660 ? 0x600 : 0x200;
+		}
 		
+		// A fully composed initial RAM image. MakeMachineImage() can build one
+		// at compile time so startup goes straight to Step with no file I/O
+		// and nothing to fix up.
+		struct MachineImage
+		{
+			std::array<std::byte, 4096> ram;
+			uint16_t pc;
+		};
+	
 	public:
 		CHIP8();
 		
+		// The frame sequence counter is atomic, which would otherwise delete
+		// these; copies go through the snapshot path and start with their own
+		// (unshared) published frame
+		CHIP8(const CHIP8& other);
+		CHIP8& operator=(const CHIP8& other);
+		
 	public:
+		// Reset to power-on state without reallocating anything, so pooled
+		// instances can be reused across ROMs cheaply
+		void ReInit();
+		
 		bool Load(const ROM& rom, Program type);
-		void Step(std::size_t instructions);
+		bool Load(const void * data, std::size_t size, Program type);
+		bool Load(const MachineImage& image);
+		// What stopped a Step call early, so hosts can park an instance
+		// instead of polling it: a WaitingForKey instance makes no progress
+		// until a key event or keyboard state arrives to resume it.
+		enum class StepResult
+		{
+			Completed,		// ran its whole budget
+			WaitingForKey,	// parked on Fx0A with no key available
+			Halted,			// stopped for good via 00FD
+		};
+		
+		StepResult Step(std::size_t instructions);
+		
+		// Like Step, but the budget is in emulated cycles: each opcode is
+		// charged from a relative cost table (a draw is worth dozens of ALU
+		// ops), so hosts pacing by real time don't drift on sprite-heavy
+		// ROMs. Returns the cycles consumed, which may overshoot the budget
+		// by the cost of the final instruction.
+		std::size_t StepCycles(std::size_t cycleBudget);
+		
+		std::size_t RunUntil(Clock::time_point deadline, std::size_t maxInstructions);
 		void Tick();
-		void SetKeyboardState(KeyboardState state) { mKeyboard = state; }
-		bool PlayingSound() const { return mSoundTimer > 0; }
+		void SetKeyboardState(KeyboardState state);
+		void SetSeed(uint64_t seed);
+		
+		// Queue a single key transition instead of replacing the whole state.
+		// Step applies queued events in one batch, and a pending Fx0A consumes
+		// them one at a time so a press/release pair can't be collapsed away.
+		void PushKeyEvent(uint8_t key, bool down);
+		bool PlayingSound() const { return SoundTimerValue() > 0; }
+		
+		// With lazy timers on, Fx15/Fx18 record the value and the instruction
+		// count it was set at, and reads derive the current value from how
+		// many nominal timer periods have elapsed since. Tick() then has
+		// nothing to do, so batch hosts can run millions of instructions
+		// without breaking out at 60 Hz for timer bookkeeping.
+		void SetLazyTimers(bool lazy);
+		
+		// Whether the program has stopped itself for good via 00FD
+		bool Halted() const { return mHalted; }
+		
+		// Total instructions executed since power-on; the counter snapshots
+		// and replays use to line events up
+		uint64_t GetInstructionCount() const { return mInstructionCount; }
+		
+		// Whether the program is parked on Fx0A with nothing queued that
+		// could wake it; schedulers skip such instances until a key arrives
+		bool WaitingForKey() const { return mKeyboardRegister != 0xFF && !mKeyboard.any() && mKeyEvents.empty(); }
+		
+		// Active display geometry; SCHIP hires mode is 128x64
+		std::size_t DisplayWidth() const { return mHires ? kHiresDisplayWidth : kDisplayWidth; }
+		std::size_t DisplayHeight() const { return mHires ? kHiresDisplayHeight : kDisplayHeight; }
+		// Where Draw() delivers frames; defaults to the terminal renderer.
+		// The sink must outlive the emulator or be cleared with nullptr.
+		void SetFrameSink(FrameSink * sink) { mFrameSink = sink; }
+		
 		void Dump() const;
+		
+		// Print the flight-recorder trace: the last kTraceLength instructions
+		// executed, oldest first. Dumped automatically when OnError fires.
+		void DumpTrace() const;
+		
 		bool NeedsRedraw() const;
+		
+		// Copy the last published frame into dst without blocking the
+		// interpreter: frames are double buffered and sealed with a seqlock,
+		// so a renderer on another thread just retries the copy on the rare
+		// occasion Step publishes mid-read. Returns a generation counter that
+		// only advances when the frame content changed. The buffer is always
+		// kHiresDisplaySize bytes; lores frames occupy the first kDisplaySize.
+		uint32_t GetDisplayFrame(std::byte * dst, std::size_t size) const;
 		void Draw();
 		
+		// Expand the packed 1-bit display into a caller-provided RGBA buffer
+		// of DisplayWidth() * DisplayHeight() pixels, white for set and
+		// transparent black for clear
+		void DrawInto(uint8_t * rgba);
+		
+		// Narrow the pending redraw down to the rows whose pixels actually
+		// changed since the last Draw()/DrawInto(). Returns false and leaves
+		// the outputs alone when nothing really changed.
+		bool GetChangedRows(std::size_t& firstRow, std::size_t& lastRow) const;
+	
+#if defined(CHIP8_INSTRUMENTATION)
+	public:
+		// Execution counters gathered by Step. Only present when the build
+		// opts in, so the hot loop pays nothing when they're off.
+		struct Stats
+		{
+			std::array<uint64_t, 16> opcodeCounts;	// per top-level opcode family
+			std::array<uint64_t, 32> pcRangeCounts;	// per 128-byte window of RAM
+		};
+		
+		const Stats& GetStats() const { return mStats; }
+		void ResetStats() { mStats = {}; }
+#endif
+	
+	public:
+		// A fixed-layout copy of the architectural state, cheap to capture and
+		// hand between instances
+		struct Snapshot
+		{
+			std::array<std::byte, 4096> ram;
+			std::array<std::byte, 1024> displayBuffer;
+			std::array<std::byte, 1024> hiresDisplay;
+			std::array<uint8_t, 16> registers;
+			std::array<uint8_t, 8> userFlags;
+			uint16_t pc;
+			uint16_t i;
+			uint8_t delayTimer;
+			uint8_t soundTimer;
+			uint16_t keyboard;
+			uint8_t keyboardRegister;
+			uint8_t stack;
+			uint8_t hires;
+			uint8_t halted;
+			std::array<uint16_t, 24> stackFrames;
+			uint64_t instructionCount;
+			uint64_t rngState;
+			uint64_t delaySetAt;
+			uint64_t soundSetAt;
+			uint8_t lazyTimers;
+		};
+		
+		using SharedSnapshot = std::shared_ptr<const Snapshot>;
+		
+		Snapshot TakeSnapshot() const;
+		void Restore(const Snapshot& snapshot);
+		
+		// FNV-1a over the snapshot bytes, so differential runs can compare
+		// one 8-byte value per checkpoint instead of parsing Dump() text
+		uint64_t StateHash() const;
+		
+		// Capture a snapshot that many forks can restore from without each
+		// needing their own copy up front
+		SharedSnapshot ShareSnapshot() const;
+		static CHIP8 Fork(const SharedSnapshot& snapshot);
+	
+	public:
+		// On-disk image of a snapshot: a fixed header followed by the raw
+		// snapshot bytes, so a checkpoint can be mapped straight back in
+		// without any parsing
+		struct SaveState
+		{
+			uint32_t magic;
+			uint32_t version;
+			Snapshot state;
+		};
+		static_assert(std::is_trivially_copyable_v<SaveState>, "Savestates are written and mapped as raw bytes");
+		
+		static constexpr uint32_t kSaveStateMagic = 0x43383053;	// "S08C" on disk
+		static constexpr uint32_t kSaveStateVersion = 2;
+		
+		bool SaveStateTo(const char* path) const;
+		bool LoadStateFrom(const char* path);
+	
+	public:
+		// A log of the inputs a run received, keyed by the instruction counter,
+		// so an interactive session can be replayed headless at full speed
+		struct InputRecording
+		{
+			enum class Type : uint8_t
+			{
+				Keyboard,
+				Tick,
+			};
+			
+			struct Event
+			{
+				uint64_t instruction;
+				Type type;
+				uint16_t keyboard;
+			};
+			
+			std::vector<Event> events;
+		};
+		
+		// Log keyboard changes and timer ticks into the given recording until
+		// told otherwise with nullptr
+		void RecordInto(InputRecording * recording) { mRecording = recording; }
+		
+		// Re-run a recording's inputs from the current state, stepping flat out
+		// between events instead of at the original wall-clock pace
+		void Replay(const InputRecording& recording);
+	
 	private:
 		using Address = uint16_t;
 		using Instruction = uint16_t;
@@ -55,49 +497,330 @@ namespace emu
 		static constexpr size_t kDisplayWidth = 64;
 		static constexpr size_t kDisplayHeight = 32;
 		
+		// The SCHIP hires display quadruples the pixel count
+		static constexpr size_t kHiresDisplayWidth = 128;
+		static constexpr size_t kHiresDisplayHeight = 64;
+		static constexpr size_t kHiresDisplaySize = kHiresDisplayWidth / 8 * kHiresDisplayHeight;
+		
 	private:
-		static constexpr Address kCharacterSpritesStart = 0x0010;
+		static constexpr Address kCharacterSpritesStart = detail::kCharacterSpritesStart;
+		static constexpr Address kBigCharacterSpritesStart = detail::kBigCharacterSpritesStart;
+	
+	private:
+		// How many instructions make up one 60 Hz timer period, assuming the
+		// nominal ~1 kHz instruction rate that hosts have always used
+		static constexpr std::size_t kInstructionsPerTick = 20;
+		
+	private:
+		// A translated instruction: the raw encoding, its operand fields
+		// already extracted, and an index into kHandlers. Filled in lazily the
+		// first time an address is executed so that re-running the same code
+		// skips the fetch, dispatch, and field extraction work.
+		struct DecodedOp
+		{
+			Instruction ins;
+			Address nnn;
+			uint8_t rx;
+			uint8_t ry;
+			uint8_t nn;
+			uint8_t n;
+			uint8_t handler;
+		};
+		
+		// Indexes into kHandlers. Every sub-opcode resolves to its own entry
+		// when an address is translated, so Step makes a single table call with
+		// no secondary switch inside the handler.
+		enum : uint8_t
+		{
+			kHandler_Cls,
+			kHandler_Ret,
+			kHandler_ScrollDown,
+			kHandler_ScrollRight,
+			kHandler_ScrollLeft,
+			kHandler_Exit,
+			kHandler_LoresMode,
+			kHandler_HiresMode,
+			kHandler_Jump,
+			kHandler_Call,
+			kHandler_SkipEqualImm,
+			kHandler_SkipNotEqualImm,
+			kHandler_SkipEqual,
+			kHandler_SetImm,
+			kHandler_AddImm,
+			kHandler_Set,
+			kHandler_Or,
+			kHandler_And,
+			kHandler_Xor,
+			kHandler_Add,
+			kHandler_Sub,
+			kHandler_ShiftRight,
+			kHandler_SubFrom,
+			kHandler_ShiftLeft,
+			kHandler_SkipNotEqual,
+			kHandler_SetI,
+			kHandler_JumpV0,
+			kHandler_Random,
+			kHandler_Draw,
+			kHandler_SkipKeyPressed,
+			kHandler_SkipKeyNotPressed,
+			kHandler_GetDelay,
+			kHandler_WaitKey,
+			kHandler_SetDelay,
+			kHandler_SetSound,
+			kHandler_AddI,
+			kHandler_CharacterSprite,
+			kHandler_BigCharacterSprite,
+			kHandler_StoreBCD,
+			kHandler_StoreRegisters,
+			kHandler_LoadRegisters,
+			kHandler_StoreUserFlags,
+			kHandler_LoadUserFlags,
+			kHandler_Unknown,
+			kHandlerCount,
+		};
+		
+		using Handler = void (CHIP8::*)(const DecodedOp&);
+		static const Handler kHandlers[kHandlerCount];
 		
+		// ROM::Analyze() classifies instructions through ResolveHandler so
+		// the two can't drift apart
+		friend class ROM;
+		
+		// Relative cycle cost per handler, indexed the same as kHandlers
+		static const uint8_t kHandlerCycles[kHandlerCount];
+		
+		// Marks a decode cache entry that hasn't been translated yet
+		static constexpr uint8_t kNotDecoded = 0xFF;
+	
 	private:
 		[[noreturn]] void OnError(const char * msg) const;
-		Instruction ReadInstruction();
+		std::size_t StepBudget(std::size_t budget, const uint8_t * cycleCosts);
+		static uint8_t ResolveHandler(Instruction ins);
+		const DecodedOp& Decode();
+		void InvalidateDecodeCache(std::size_t start, std::size_t length);
+		void MarkDisplayDirty(std::size_t firstRow, std::size_t lastRow);
+		void MarkDisplayBytesDirty(std::size_t start, std::size_t length);
+		void PublishFrame();
+		uint8_t NextRandom();
+		
+		// Bounds policy for single-address uses of RAM. The precise build
+		// traps addresses that left the 4 KB window; CHIP8_FAST_BOUNDS masks
+		// them back into it instead, which folds into the address arithmetic
+		// and costs nothing on the hot path. Block copies (Fx33/55/65) keep
+		// their precise checks in both modes since a masked base can still
+		// run a multi-byte access off the end of RAM.
+		Address CheckedAddress(std::size_t address, const char * what) const
+		{
+#if defined(CHIP8_FAST_BOUNDS)
+			(void)what;
+			return address & (mRAM.size() - 1);
+#else
+			if (address >= mRAM.size())
+			{
+				OnError(what);
+			}
+			return static_cast<Address>(address);
+#endif
+		}
+		
+		// Current timer values under either policy: eager timers hold the
+		// live value, lazy ones derive it from the elapsed instruction count
+		Register DelayTimerValue() const { return TimerValue(mDelayTimer, mDelaySetAt); }
+		Register SoundTimerValue() const { return TimerValue(mSoundTimer, mSoundSetAt); }
+		Register TimerValue(Register value, uint64_t setAt) const
+		{
+			if (!mLazyTimers)
+			{
+				return value;
+			}
+			const uint64_t elapsed = (mInstructionCount - setAt) / kInstructionsPerTick;
+			return value > elapsed ? static_cast<Register>(value - elapsed) : 0;
+		}
+		
+		// The active display's backing storage and layout
+		std::byte * DisplayData() { return mHires ? mHiresDisplay.data() : &mRAM[kDisplayStart]; }
+		const std::byte * DisplayData() const { return mHires ? mHiresDisplay.data() : &mRAM[kDisplayStart]; }
+		std::size_t DisplayPitch() const { return DisplayWidth() / 8; }
+		std::size_t DisplaySize() const { return mHires ? kHiresDisplaySize : kDisplaySize; }
+		
+		void SetDisplayMode(bool hires);
+		void InvalidateDisplayCode();
 		
+		// A key transition queued by PushKeyEvent()
+		struct KeyEvent
+		{
+			uint8_t key;
+			bool down;
+		};
+		
+		void ApplyKeyEvent(const KeyEvent& event);
+	
 	private:
 		[[noreturn]] void Unhandled(Instruction);
-		void Handle_0(Instruction);
-		void Handle_1(Instruction);
-		void Handle_2(Instruction);
-		void Handle_3(Instruction);
-		void Handle_4(Instruction);
-		void Handle_5(Instruction);
-		void Handle_6(Instruction);
-		void Handle_7(Instruction);
-		void Handle_8(Instruction);
-		void Handle_9(Instruction);
-		void Handle_A(Instruction);
-		void Handle_B(Instruction);
-		void Handle_C(Instruction);
-		void Handle_D(Instruction);
-		void Handle_E(Instruction);
-		void Handle_F(Instruction);
+		void Handle_Cls(const DecodedOp&);
+		void Handle_Ret(const DecodedOp&);
+		void Handle_ScrollDown(const DecodedOp&);
+		void Handle_ScrollRight(const DecodedOp&);
+		void Handle_ScrollLeft(const DecodedOp&);
+		void Handle_Exit(const DecodedOp&);
+		void Handle_LoresMode(const DecodedOp&);
+		void Handle_HiresMode(const DecodedOp&);
+		void Handle_Jump(const DecodedOp&);
+		void Handle_Call(const DecodedOp&);
+		void Handle_SkipEqualImm(const DecodedOp&);
+		void Handle_SkipNotEqualImm(const DecodedOp&);
+		void Handle_SkipEqual(const DecodedOp&);
+		void Handle_SetImm(const DecodedOp&);
+		void Handle_AddImm(const DecodedOp&);
+		void Handle_Set(const DecodedOp&);
+		void Handle_Or(const DecodedOp&);
+		void Handle_And(const DecodedOp&);
+		void Handle_Xor(const DecodedOp&);
+		void Handle_Add(const DecodedOp&);
+		void Handle_Sub(const DecodedOp&);
+		void Handle_ShiftRight(const DecodedOp&);
+		void Handle_SubFrom(const DecodedOp&);
+		void Handle_ShiftLeft(const DecodedOp&);
+		void Handle_SkipNotEqual(const DecodedOp&);
+		void Handle_SetI(const DecodedOp&);
+		void Handle_JumpV0(const DecodedOp&);
+		void Handle_Random(const DecodedOp&);
+		void Handle_Draw(const DecodedOp&);
+		void Handle_SkipKeyPressed(const DecodedOp&);
+		void Handle_SkipKeyNotPressed(const DecodedOp&);
+		void Handle_GetDelay(const DecodedOp&);
+		void Handle_WaitKey(const DecodedOp&);
+		void Handle_SetDelay(const DecodedOp&);
+		void Handle_SetSound(const DecodedOp&);
+		void Handle_AddI(const DecodedOp&);
+		void Handle_CharacterSprite(const DecodedOp&);
+		void Handle_BigCharacterSprite(const DecodedOp&);
+		void Handle_StoreBCD(const DecodedOp&);
+		void Handle_StoreRegisters(const DecodedOp&);
+		void Handle_LoadRegisters(const DecodedOp&);
+		void Handle_StoreUserFlags(const DecodedOp&);
+		void Handle_LoadUserFlags(const DecodedOp&);
+		void Handle_Unknown(const DecodedOp&);
 		
 	private:
-		std::array<std::byte, 4096> mRAM;
-		std::array<std::byte, kDisplaySize> mDisplayBuffer;
-		
-		std::array<Register, 16> mRegisters;
+		// Members are laid out hot-first: the interpreter state every
+		// instruction touches packs into the leading cache lines, and the big
+		// cold arrays (RAM, displays, decode cache, trace) come after, so a
+		// pool of instances round-robined by the scheduler only drags each
+		// instance's head through the caches.
 		Address mPC;
 		Address mI;
+		std::array<Register, 16> mRegisters;
+		size_t mStack;
 		
 		Register mDelayTimer;
 		Register mSoundTimer;
+		uint8_t mKeyboardRegister; // 0xFF indicates not waiting
+		
+		// When each timer was set, for the lazy policy. The policy itself is
+		// host configuration and survives ReInit().
+		bool mLazyTimers;
+		uint64_t mDelaySetAt;
+		uint64_t mSoundSetAt;
+		
+		bool mHires;
+		bool mHalted; // set by 00FD; Step stops running once halted
+		bool mDecodeInDisplay; // whether any code has run from display RAM
+		
+		// Which display rows have changed since the last Draw(), so redraw
+		// checks don't have to compare the whole frame
+		bool mDisplayDirty;
+		uint8_t mDirtyRowFirst;
+		uint8_t mDirtyRowLast;
+		bool mFramePending; // display changed since the last publish
 		
 		std::bitset<16> mKeyboard;
-		uint8_t mKeyboardRegister; // 0xFF indicates not waiting
+		
+		uint64_t mInstructionCount;
+		uint64_t mTraceCount;
+		
+		// Per-instance PRNG state so Cxnn doesn't go through libc's locked
+		// rand(), and so runs can be made reproducible via SetSeed()
+		uint64_t mRngState;
 		
 		std::array<Address, 24> mStackFrames;
-		size_t mStack;
+		std::array<Register, 8> mUserFlags; // the SCHIP RPL flags (Fx75/Fx85)
+		
+		// Where inputs get logged while a recording is active
+		InputRecording * mRecording;
+		
+		// Where Draw() sends frames; nullptr means the terminal renderer
+		FrameSink * mFrameSink;
+		uint64_t mFrameCounter;
+		
+		// Key transitions waiting to be applied by Step
+		std::vector<KeyEvent> mKeyEvents;
+		
+		mutable std::atomic<uint32_t> mFrameSeq;
+		
+		// Flight recorder: Step writes one record per instruction into a
+		// power-of-two ring, costing a couple of stores when nothing is wrong
+		struct TraceRecord
+		{
+			Address pc;
+			Instruction ins;
+		};
+		static constexpr std::size_t kTraceLength = 256;
+		std::array<TraceRecord, kTraceLength> mTrace;
+		
+		std::array<DecodedOp, 4096> mDecodeCache;
+		
+		std::array<std::byte, 4096> mRAM;
+		std::array<std::byte, kHiresDisplaySize> mDisplayBuffer;
+		
+		// The hires display doesn't fit in RAM so it lives outside it, which
+		// also means code can never execute from it
+		std::array<std::byte, kHiresDisplaySize> mHiresDisplay;
+		
+		// The seqlock-published copy of the display for GetDisplayFrame().
+		// Odd sequence values mean a publish is in flight; the generation a
+		// reader sees is the sequence halved.
+		std::array<std::byte, kHiresDisplaySize> mFrontBuffer;
+
+#if defined(CHIP8_INSTRUMENTATION)
+		Stats mStats;
+#endif
 	};
+	
+	
+	// Compose a MachineImage from a ROM baked into the binary. Evaluating this
+	// in a constexpr context does all of the load work at compile time; a ROM
+	// that doesn't fit becomes a compile error instead of a throw.
+	template <std::size_t N>
+	constexpr CHIP8::MachineImage MakeMachineImage(const uint8_t (&rom)[N], CHIP8::Program type)
+	{
+		CHIP8::MachineImage image{};
+		
+		const std::size_t offset = CHIP8::EntryPoint(type);
+		if (N + offset >= image.ram.size())
+		{
+			throw std::runtime_error("ROM does not fit in RAM");
+		}
+		
+		for (std::size_t i = 0; i < N; i++)
+		{
+			image.ram[offset + i] = std::byte{rom[i]};
+		}
+		
+		for (std::size_t i = 0; i < sizeof(detail::kCharacterSprites); i++)
+		{
+			image.ram[detail::kCharacterSpritesStart + i] = std::byte{detail::kCharacterSprites[i]};
+		}
+		
+		for (std::size_t i = 0; i < detail::kBigCharacterSprites.size(); i++)
+		{
+			image.ram[detail::kBigCharacterSpritesStart + i] = std::byte{detail::kBigCharacterSprites[i]};
+		}
+		
+		image.pc = offset;
+		
+		return image;
+	}
 }
 
 #endif
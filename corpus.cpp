@@ -0,0 +1,157 @@
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "chip8.h"
+
+
+namespace
+{
+	// How much emulated work each ROM gets before we call it done; cycles
+	// rather than instructions so draw-heavy ROMs don't run long
+	constexpr std::size_t kCycleBudget = 200'000;
+	
+	void usage(const char * name)
+	{
+		printf("Usage: %s <rom directory | manifest file>\n", name);
+	}
+	
+	// A directory is walked for ROMs; anything else is read as a manifest
+	// with one ROM path per line
+	std::vector<std::string> CollectROMs(const char * path)
+	{
+		std::vector<std::string> roms;
+		
+		std::error_code ec;
+		if (std::filesystem::is_directory(path, ec))
+		{
+			for (const auto& entry : std::filesystem::recursive_directory_iterator(path, ec))
+			{
+				if (entry.is_regular_file())
+				{
+					roms.push_back(entry.path().string());
+				}
+			}
+		}
+		else
+		{
+			std::ifstream manifest(path);
+			std::string line;
+			while (std::getline(manifest, line))
+			{
+				if (!line.empty())
+				{
+					roms.push_back(line);
+				}
+			}
+		}
+		
+		return roms;
+	}
+	
+	// Run one ROM on an already-constructed instance and print its result line
+	void RunROM(emu::CHIP8& chip8, const std::string& path, std::mutex& output)
+	{
+		emu::ROM rom;
+		if (!rom.LoadFile(path.c_str()))
+		{
+			std::lock_guard<std::mutex> lock(output);
+			printf("%-48s open-failed\n", path.c_str());
+			return;
+		}
+		
+		// Reset the pooled instance rather than constructing a fresh one
+		chip8.ReInit();
+		if (!chip8.Load(rom, emu::CHIP8::Program::CHIP8))
+		{
+			std::lock_guard<std::mutex> lock(output);
+			printf("%-48s load-failed\n", path.c_str());
+			return;
+		}
+		
+		const char * status = "ok";
+		std::size_t cycles = 0;
+		try
+		{
+			while (cycles < kCycleBudget)
+			{
+				// A timer period's worth of work at a time, same as main.cpp
+				const std::size_t consumed = chip8.StepCycles(20);
+				chip8.Tick();
+				
+				if (consumed == 0)
+				{
+					// Either the ROM exited or it's waiting on a key press
+					status = chip8.Halted() ? "halted" : "blocked";
+					break;
+				}
+				cycles += consumed;
+			}
+		}
+		catch (const std::exception& e)
+		{
+			std::lock_guard<std::mutex> lock(output);
+			printf("%-48s error: %s\n", path.c_str(), e.what());
+			return;
+		}
+		
+		std::lock_guard<std::mutex> lock(output);
+		printf("%-48s %-8s %8zu cycles\n", path.c_str(), status, cycles);
+	}
+}
+
+
+
+int main(int argc, char**argv)
+{
+	if (argc != 2)
+	{
+		usage(argv[0]);
+		return 0;
+	}
+	
+	const std::vector<std::string> roms = CollectROMs(argv[1]);
+	if (roms.empty())
+	{
+		printf("No ROMs found in \"%s\"\n", argv[1]);
+		return 1;
+	}
+	
+	// One long-lived instance per worker; ROMs are claimed with an atomic
+	// counter the same way the Scheduler hands out instances
+	const std::size_t workerCount = std::max<std::size_t>(1, std::thread::hardware_concurrency());
+	std::atomic<std::size_t> next{0};
+	std::mutex output;
+	
+	std::vector<std::thread> workers;
+	for (std::size_t i = 0; i < workerCount; i++)
+	{
+		workers.emplace_back([&]()
+		{
+			emu::CHIP8 chip8;
+			while (true)
+			{
+				const std::size_t index = next.fetch_add(1);
+				if (index >= roms.size())
+				{
+					break;
+				}
+				RunROM(chip8, roms[index], output);
+			}
+		});
+	}
+	for (auto& worker : workers)
+	{
+		worker.join();
+	}
+	
+	printf("%zu ROMs run on %zu workers\n", roms.size(), workerCount);
+	
+	return 0;
+}
@@ -0,0 +1,78 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+#include "chip8.h"
+
+
+namespace
+{
+	void usage(const char * name)
+	{
+		printf("Usage: %s rom [instructions] [interval]\n", name);
+	}
+}
+
+
+
+int main(int argc, char**argv)
+{
+	if (argc < 2 || argc > 4)
+	{
+		usage(argv[0]);
+		return 0;
+	}
+	
+	const std::size_t instructions = argc > 2 ? strtoull(argv[2], nullptr, 0) : 1'000'000;
+	const std::size_t interval = argc > 3 ? strtoull(argv[3], nullptr, 0) : 10'000;
+
+	
+	// Try and load the ROM by mapping the file straight in
+	emu::ROM rom;
+	{
+		const char * romPath = argv[1];
+		if (!rom.LoadFile(romPath))
+		{
+			printf("Failed to open file: \"%s\"\n", romPath);
+			return 1;
+		}
+	}
+
+	
+	// Load the ROM into the emulator. Lazy timers keep the run a pure
+	// function of the instruction count, so two versions stepping the same
+	// ROM produce comparable hashes with no host timing involved.
+	emu::CHIP8 chip8;
+	chip8.SetLazyTimers(true);
+	if (!chip8.Load(rom, emu::CHIP8::Program::CHIP8))
+	{
+		printf("Failed to load ROM into emulator.\n");
+		return 1;
+	}
+	
+	// One "instructions hash" line per interval; a differential run diffs
+	// two of these streams instead of parsing Dump() text
+	std::size_t executed = 0;
+	try
+	{
+		while (executed < instructions)
+		{
+			const auto result = chip8.Step(std::min(interval, instructions - executed));
+			executed += std::min(interval, instructions - executed);
+			printf("%12zu %016llX\n", executed, static_cast<unsigned long long>(chip8.StateHash()));
+			
+			if (result != emu::CHIP8::StepResult::Completed)
+			{
+				printf("stopped: %s\n", result == emu::CHIP8::StepResult::Halted ? "halted" : "waiting for key");
+				break;
+			}
+		}
+	}
+	catch (const std::exception& e)
+	{
+		printf("fault: %s %016llX\n", e.what(), static_cast<unsigned long long>(chip8.StateHash()));
+		return 1;
+	}
+	
+	return 0;
+}
@@ -0,0 +1,61 @@
+#include <thread>
+
+#include "governor.h"
+
+namespace emu
+{
+	Governor::Governor(CHIP8& chip8, uint64_t instructionsPerSecond)
+		: mCHIP8{chip8}
+		, mRate{instructionsPerSecond}
+		, mFrame{0}
+		, mBase{chip8.GetInstructionCount()}
+		, mStart{CHIP8::Clock::now()}
+	{
+	}
+	
+	bool Governor::RunFrame()
+	{
+		// Both the deadline and the instructions owed by it derive from the
+		// frame index in integer math, so rounding never accumulates and the
+		// effective rate tracks the target over any window
+		mFrame++;
+		const auto deadline = mStart + std::chrono::nanoseconds(mFrame * 1'000'000'000ull / 60);
+		const uint64_t target = mFrame * mRate / 60;
+		
+		// Run whatever this frame is owed; after an overrun that debt spans
+		// more than one frame's worth and the batch grows to match
+		const uint64_t executed = mCHIP8.GetInstructionCount() - mBase;
+		if (target > executed)
+		{
+			const auto result = mCHIP8.Step(target - executed);
+			
+			// Time spent parked on Fx0A is not a debt: re-baseline the
+			// schedule so the key press resumes at the target rate instead
+			// of slamming through the whole wait's worth of instructions
+			if (result == CHIP8::StepResult::WaitingForKey)
+			{
+				mBase = mCHIP8.GetInstructionCount();
+				mFrame = 0;
+				mStart = deadline;
+			}
+		}
+		mCHIP8.Tick();
+		
+		if (mCHIP8.NeedsRedraw())
+		{
+			mCHIP8.Draw();
+		}
+		
+		// Sleep off the residual; an overrun makes this return immediately
+		std::this_thread::sleep_until(deadline);
+		
+		return !mCHIP8.Halted();
+	}
+	
+	void Governor::Run()
+	{
+		while (RunFrame())
+		{
+		}
+	}
+}
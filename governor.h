@@ -0,0 +1,36 @@
+#ifndef GOVERNOR_H
+#define GOVERNOR_H
+
+#include "chip8.h"
+
+namespace emu
+{
+	// Paces a CHIP8 at a target instructions-per-second rate off absolute
+	// 60 Hz deadlines. Each frame runs however many instructions the target
+	// clock says are owed by that deadline, so a host that stalls under load
+	// pays the debt back with a bigger batch on the next frame instead of
+	// drifting, and a host that's ahead sleeps off only the residual.
+	class Governor
+	{
+	public:
+		Governor(CHIP8& chip8, uint64_t instructionsPerSecond);
+	
+	public:
+		// Run one 60 Hz frame: step the owed batch, tick the timers, draw if
+		// needed and sleep until the frame's absolute deadline. Returns false
+		// once the program has halted for good.
+		bool RunFrame();
+		
+		// Frame loop until the program halts
+		void Run();
+	
+	private:
+		CHIP8& mCHIP8;
+		uint64_t mRate;
+		uint64_t mFrame;	// frames dispatched since mStart
+		uint64_t mBase;		// the instruction count when pacing began
+		CHIP8::Clock::time_point mStart;
+	};
+}
+
+#endif
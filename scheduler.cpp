@@ -0,0 +1,222 @@
+#include <new>
+#include <stdexcept>
+
+#include "scheduler.h"
+
+namespace emu
+{
+	namespace
+	{
+		// Space arena slots out to cache-line multiples so two instances
+		// never share a line
+		constexpr std::size_t kArenaAlignment = 64;
+	}
+	
+	InstanceArena::InstanceArena(std::size_t capacity)
+		: mSlab{nullptr}
+		, mStride{(sizeof(CHIP8) + kArenaAlignment - 1) & ~(kArenaAlignment - 1)}
+		, mCapacity{capacity}
+		, mCount{0}
+	{
+		mSlab = static_cast<std::byte*>(::operator new(mStride * mCapacity, std::align_val_t{kArenaAlignment}));
+	}
+	
+	InstanceArena::~InstanceArena()
+	{
+		for (std::size_t i = 0; i < mCount; i++)
+		{
+			Slot(i)->~CHIP8();
+		}
+		::operator delete(mSlab, std::align_val_t{kArenaAlignment});
+	}
+	
+	CHIP8 * InstanceArena::Slot(std::size_t index) const
+	{
+		return reinterpret_cast<CHIP8*>(mSlab + index * mStride);
+	}
+	
+	CHIP8& InstanceArena::Create()
+	{
+		if (mCount >= mCapacity)
+		{
+			throw std::runtime_error("Arena is full");
+		}
+		
+		CHIP8 * instance = new (Slot(mCount)) CHIP8();
+		mCount++;
+		return *instance;
+	}
+	
+	
+	Scheduler::Scheduler(std::size_t workerCount)
+		: mOwned{}
+		, mInstances{}
+		, mFaulted{}
+		, mWorkers{}
+		, mMutex{}
+		, mWork{}
+		, mDone{}
+		, mRound{}
+		, mInstructions{}
+		, mClaim{}
+		, mRemaining{}
+		, mShutdown{false}
+	{
+		// Always have at least one worker so StepAll() can make progress
+		if (workerCount == 0)
+		{
+			workerCount = 1;
+		}
+		
+		for (std::size_t i = 0; i < workerCount; i++)
+		{
+			mWorkers.emplace_back(&Scheduler::Worker, this);
+		}
+	}
+	
+	Scheduler::~Scheduler()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mShutdown = true;
+		}
+		mWork.notify_all();
+		
+		for (auto& worker : mWorkers)
+		{
+			worker.join();
+		}
+	}
+	
+	std::size_t Scheduler::AddInstance(CHIP8 instance)
+	{
+		mOwned.push_back(std::move(instance));
+		mInstances.push_back(&mOwned.back());
+		mFaulted.push_back(false);
+		return mInstances.size() - 1;
+	}
+	
+	std::size_t Scheduler::Attach(InstanceArena& arena)
+	{
+		const std::size_t first = mInstances.size();
+		
+		for (std::size_t i = 0; i < arena.Count(); i++)
+		{
+			mInstances.push_back(&arena.Get(i));
+			mFaulted.push_back(false);
+		}
+		
+		return first;
+	}
+	
+	void Scheduler::StepAll(std::size_t instructions)
+	{
+		if (mInstances.empty())
+		{
+			return;
+		}
+		
+		// Kick off a round
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mInstructions = instructions;
+			mRound++;
+			mClaim.store(static_cast<uint64_t>(static_cast<uint32_t>(mRound)) << 32);
+			mRemaining.store(mInstances.size());
+		}
+		mWork.notify_all();
+		
+		// Wait for the workers to drain it
+		std::unique_lock<std::mutex> lock(mMutex);
+		mDone.wait(lock, [this]() { return mRemaining.load() == 0; });
+	}
+	
+	void Scheduler::TickAll()
+	{
+		for (auto * instance : mInstances)
+		{
+			instance->Tick();
+		}
+	}
+	
+	void Scheduler::Worker()
+	{
+		std::size_t lastRound = 0;
+		
+		while (true)
+		{
+			// Wait for a round to be dispatched, and snapshot its parameters
+			// under the lock: once we're claiming we never touch them again,
+			// so a caller mutating the pool after StepAll() returns can't race
+			// a straggler in here
+			std::size_t count;
+			std::size_t instructions;
+			{
+				std::unique_lock<std::mutex> lock(mMutex);
+				mWork.wait(lock, [&]() { return mShutdown || mRound != lastRound; });
+				
+				if (mShutdown)
+				{
+					return;
+				}
+				
+				lastRound = mRound;
+				count = mInstances.size();
+				instructions = mInstructions;
+			}
+			const uint64_t tag = static_cast<uint64_t>(static_cast<uint32_t>(lastRound)) << 32;
+			
+			// Claim instances until the round is exhausted. The claim word
+			// carries the round it belongs to, so a slow worker re-checking
+			// for work after the round has drained backs off here instead of
+			// stealing a slot from counters StepAll() has since rearmed.
+			bool exhausted = false;
+			while (!exhausted)
+			{
+				uint64_t claim = mClaim.load();
+				std::size_t index = count;
+				while (true)
+				{
+					if ((claim >> 32) != (tag >> 32) || (claim & 0xFFFFFFFF) >= count)
+					{
+						exhausted = true;
+						break;
+					}
+					if (mClaim.compare_exchange_weak(claim, claim + 1))
+					{
+						index = static_cast<std::size_t>(claim & 0xFFFFFFFF);
+						break;
+					}
+				}
+				if (exhausted)
+				{
+					break;
+				}
+				
+				// Faulted instances stay parked, and so do ones blocked on a
+				// key press: they'd only re-test the wait and break straight
+				// back out, so their share of the round goes to instances
+				// that can actually run
+				if (!mFaulted[index] && !mInstances[index]->WaitingForKey())
+				{
+					try
+					{
+						mInstances[index]->Step(instructions);
+					}
+					catch (const std::exception&)
+					{
+						// Park the instance rather than taking the pool down
+						mFaulted[index] = 1;
+					}
+				}
+				
+				// The last instance to finish wakes up StepAll()
+				if (mRemaining.fetch_sub(1) == 1)
+				{
+					std::lock_guard<std::mutex> lock(mMutex);
+					mDone.notify_all();
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,106 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "chip8.h"
+
+namespace emu
+{
+	// Backs a pool of CHIP8 instances with one cache-line-aligned slab, so
+	// neighbouring instances sit contiguously instead of wherever the
+	// allocator scattered them and round-robin stepping walks memory
+	// sequentially instead of thrashing L2
+	class InstanceArena
+	{
+	public:
+		explicit InstanceArena(std::size_t capacity);
+		~InstanceArena();
+		
+		InstanceArena(const InstanceArena&) = delete;
+		InstanceArena& operator=(const InstanceArena&) = delete;
+	
+	public:
+		// Construct the next instance in the slab; throws once full
+		CHIP8& Create();
+		
+		CHIP8& Get(std::size_t index) { return *Slot(index); }
+		std::size_t Count() const { return mCount; }
+		std::size_t Capacity() const { return mCapacity; }
+	
+	private:
+		CHIP8 * Slot(std::size_t index) const;
+	
+	private:
+		std::byte * mSlab;
+		std::size_t mStride;
+		std::size_t mCapacity;
+		std::size_t mCount;
+	};
+	
+	
+	// Steps a pool of independent CHIP8 instances across a set of worker
+	// threads and multiplexes their 60Hz timers off one clock. Workers claim
+	// instances with an atomic counter, so a thread that finishes its share
+	// early just keeps claiming work from the slower ones.
+	class Scheduler
+	{
+	public:
+		explicit Scheduler(std::size_t workerCount);
+		~Scheduler();
+		
+		Scheduler(const Scheduler&) = delete;
+		Scheduler& operator=(const Scheduler&) = delete;
+	
+	public:
+		// Instances must not be added while a StepAll() is in flight. Added
+		// instances are owned by the scheduler; attached ones stay in their
+		// arena, which must outlive it.
+		std::size_t AddInstance(CHIP8 instance);
+		std::size_t Attach(InstanceArena& arena);
+		CHIP8& GetInstance(std::size_t index) { return *mInstances[index]; }
+		std::size_t InstanceCount() const { return mInstances.size(); }
+		
+		// Step every instance by the given number of instructions, spread
+		// across the workers, and block until they've all finished
+		void StepAll(std::size_t instructions);
+		
+		// Advance every instance's timers by one 60Hz tick
+		void TickAll();
+		
+		// Whether an instance has thrown out of Step(); faulted instances are
+		// skipped by later rounds
+		bool HasFaulted(std::size_t index) const { return mFaulted[index] != 0; }
+		
+		// Whether an instance is parked waiting on a key press. Parked
+		// instances are skipped by StepAll() rounds, so the core they'd have
+		// spun on goes to instances with work; pushing a key event through
+		// GetInstance() resumes them on the next round.
+		bool IsWaiting(std::size_t index) const { return mInstances[index]->WaitingForKey(); }
+	
+	private:
+		void Worker();
+	
+	private:
+		std::deque<CHIP8> mOwned;	// stable addresses for AddInstance()
+		std::vector<CHIP8*> mInstances;
+		std::vector<uint8_t> mFaulted;
+		std::vector<std::thread> mWorkers;
+		
+		std::mutex mMutex;
+		std::condition_variable mWork;
+		std::condition_variable mDone;
+		std::size_t mRound;			// bumped to dispatch a round to the workers
+		std::size_t mInstructions;	// how much to run per instance this round
+		std::atomic<uint64_t> mClaim;		// round in the top half, next unclaimed instance in the bottom
+		std::atomic<std::size_t> mRemaining;	// instances still running
+		bool mShutdown;
+	};
+}
+
+#endif